@@ -1,14 +1,18 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
-layout(location = 2) in vec2 aTexCoords;
-layout(location = 3) in mat4 aInstanceMatrix;
+layout(location = 1) in vec2 aTexCoords;
+// per-instance model matrix, see INSTANCE_MATRIX_LOCATION in instanced_model.h
+layout(location = 7) in mat4 aInstanceMatrix;
 
 out vec2 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+// see FrameUniforms in uniform_buffers.h
+layout(std140) uniform matrices {
+    mat4 projection;
+    mat4 view;
+};
 
 void main() {
     TexCoords = aTexCoords;
     gl_Position = projection * view * aInstanceMatrix * vec4(aPos, 1.0f);
-}
\ No newline at end of file
+}
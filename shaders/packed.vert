@@ -0,0 +1,57 @@
+#version 330 core
+// Decodes the quantized VertexFormat::Packed layout (see vertex_packing.h)
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aTexCoords;
+layout(location = 2) in vec2 aNormal;
+layout(location = 3) in vec2 aTangent;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out vec3 Tangent;
+out vec3 Bitangent;
+
+// see FrameUniforms and DrawUniforms in uniform_buffers.h
+layout(std140) uniform matrices {
+    mat4 projection;
+    mat4 view;
+};
+layout(std140) uniform draw {
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+// undoes the bounding box quantization of the positions
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+// smallest snorm16 step, matches SNORM16_STEP in vertex_packing.cpp
+const float SNORM16_STEP = 1.0 / 32767.0;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 signNotZero = vec2(e.x >= 0.0 ? 1.0 : -1.0,
+                                e.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signNotZero;
+    }
+    return normalize(n);
+}
+
+void main() {
+    vec3 position = positionOffset + aPos * positionScale;
+
+    vec3 normal = octDecode(aNormal);
+    // the bitangent sign lives in the sign of the tangent's y, with the
+    // magnitude remapped to [step, 1]
+    float handedness = aTangent.y < 0.0 ? -1.0 : 1.0;
+    float tangentY =
+        (abs(aTangent.y) - SNORM16_STEP) / (1.0 - SNORM16_STEP) * 2.0 - 1.0;
+    vec3 tangent = octDecode(vec2(aTangent.x, tangentY));
+
+    Normal = normalize(mat3(normalMatrix) * normal);
+    Tangent = normalize(mat3(model) * tangent);
+    Bitangent = cross(Normal, Tangent) * handedness;
+
+    TexCoords = aTexCoords;
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
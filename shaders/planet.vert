@@ -1,12 +1,18 @@
 #version 330 core
 layout(location = 0) in vec3 aPos;
-layout(location = 2) in vec2 aTexCoords;
+layout(location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// see FrameUniforms and DrawUniforms in uniform_buffers.h
+layout(std140) uniform matrices {
+    mat4 projection;
+    mat4 view;
+};
+layout(std140) uniform draw {
+    mat4 model;
+    mat4 normalMatrix;
+};
 
 void main() {
     TexCoords = aTexCoords;
@@ -0,0 +1,133 @@
+#include "asset_streamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+namespace personal::renderer::utility {
+
+ModelHandle::ModelHandle(std::shared_ptr<StreamedModel> streamed)
+    : streamed(std::move(streamed)) {}
+
+AssetState ModelHandle::state() const {
+    return streamed ? streamed->state.load(std::memory_order_acquire)
+                    : AssetState::Failed;
+}
+
+bool ModelHandle::resident() const {
+    return state() == AssetState::Resident;
+}
+
+AssimpModel* ModelHandle::get() const {
+    return resident() ? streamed->model.get() : nullptr;
+}
+
+AssetStreamer::AssetStreamer(std::size_t uploadBudget, ThreadPool& pool)
+    : uploadBudget(uploadBudget), pool(pool) {}
+
+AssetStreamer::~AssetStreamer() {
+    // the import tasks push to this object, so they must be done first
+    while (importing.load(std::memory_order_acquire) > 0)
+        std::this_thread::yield();
+
+    Completed* done = completed.exchange(nullptr, std::memory_order_acquire);
+    while (done) {
+        Completed* next = done->next;
+        delete done;
+        done = next;
+    }
+}
+
+ModelHandle AssetStreamer::load(const std::string& path, bool gamma,
+                                ImportOptions options) {
+    auto streamed = std::make_shared<StreamedModel>();
+    streamed->path = path;
+    ++frameStats.requested;
+
+    importing.fetch_add(1, std::memory_order_relaxed);
+    pool.submit([this, streamed, gamma, options]() {
+        push(new Completed{streamed, importModel(streamed->path, options),
+                           gamma, nullptr});
+        importing.fetch_sub(1, std::memory_order_release);
+    });
+    return ModelHandle(streamed);
+}
+
+void AssetStreamer::update() {
+    collect();
+    frameStats.uploadedBytes = uploadPending(uploadBudget);
+    frameStats.textures = textureUploader.stats();
+}
+
+void AssetStreamer::finish() {
+    while (!idle()) {
+        collect();
+        if (uploadPending(std::numeric_limits<std::size_t>::max()) == 0 &&
+            uploading.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    frameStats.textures = textureUploader.stats();
+}
+
+bool AssetStreamer::idle() const {
+    return importing.load(std::memory_order_acquire) == 0 &&
+           completed.load(std::memory_order_acquire) == nullptr &&
+           uploading.empty();
+}
+
+const AssetStreamer::Stats& AssetStreamer::stats() const { return frameStats; }
+
+void AssetStreamer::push(Completed* done) {
+    done->next = completed.load(std::memory_order_relaxed);
+    while (!completed.compare_exchange_weak(done->next, done,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+    }
+}
+
+void AssetStreamer::collect() {
+    Completed* done = completed.exchange(nullptr, std::memory_order_acquire);
+
+    // the stack holds the newest import first
+    std::vector<Completed*> batch;
+    for (; done; done = done->next) batch.push_back(done);
+
+    for (auto it = batch.rbegin(); it != batch.rend(); ++it) {
+        std::unique_ptr<Completed> entry(*it);
+        StreamedModel& streamed = *entry->streamed;
+        if (!entry->imported.valid) {
+            std::cout << "ERROR::ASSET_STREAMER::IMPORT_FAILED: "
+                      << streamed.path << '\n';
+            ++frameStats.failed;
+            streamed.state.store(AssetState::Failed,
+                                 std::memory_order_release);
+            continue;
+        }
+        streamed.model = std::make_unique<AssimpModel>(
+            std::move(entry->imported), entry->gamma);
+        streamed.state.store(AssetState::Uploading, std::memory_order_release);
+        uploading.push_back(entry->streamed);
+    }
+}
+
+std::size_t AssetStreamer::uploadPending(std::size_t byteBudget) {
+    // models are finished one after the other, so the first ones become
+    // usable as early as possible
+    std::size_t uploaded = 0;
+    std::size_t finished = 0;
+    for (; finished < uploading.size() && uploaded < byteBudget; ++finished) {
+        StreamedModel& streamed = *uploading[finished];
+        uploaded += streamed.model->upload(byteBudget - uploaded, &textureUploader);
+        if (!streamed.model->resident()) break;
+
+        ++frameStats.resident;
+        streamed.state.store(AssetState::Resident, std::memory_order_release);
+    }
+    uploading.erase(uploading.begin(),
+                    uploading.begin() + static_cast<std::ptrdiff_t>(finished));
+    return uploaded;
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,111 @@
+#ifndef ASSET_STREAMER_H
+#define ASSET_STREAMER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "model.h"
+#include "texture_uploader.h"
+#include "thread_pool.h"
+
+namespace personal::renderer::utility {
+
+// Loading state of a model requested from an AssetStreamer
+enum class AssetState { Importing, Uploading, Resident, Failed };
+
+// Shared between the streamer and whoever asked for the model
+struct StreamedModel {
+    std::string path;
+    std::atomic<AssetState> state{AssetState::Importing};
+    // set once the import finished; only touched on the render thread
+    std::unique_ptr<AssimpModel> model;
+};
+
+// Refers to a model being streamed in. Cheap to copy.
+class ModelHandle {
+   public:
+    ModelHandle() = default;
+    explicit ModelHandle(std::shared_ptr<StreamedModel> streamed);
+
+    AssetState state() const;
+    bool resident() const;
+    // the model once it's resident, nullptr until then. Callers skip drawing
+    // it in the meantime.
+    AssimpModel* get() const;
+
+   private:
+    std::shared_ptr<StreamedModel> streamed;
+};
+
+// Loads models without blocking the render thread. load() returns right away
+// and runs the import (mesh cache or assimp, vertex conversion, texture
+// decoding) on the thread pool. Finished imports are handed back through a
+// lock-free queue, and update() uploads them on the render thread, spreading
+// the uploads over frames so no frame uploads much more than the budget.
+class AssetStreamer {
+   public:
+    static const std::size_t DEFAULT_UPLOAD_BUDGET = 8 * 1024 * 1024;
+
+    struct Stats {
+        std::size_t requested{0};
+        std::size_t resident{0};
+        std::size_t failed{0};
+        // bytes uploaded by the last update()
+        std::size_t uploadedBytes{0};
+        // totals of every texture upload so far
+        TextureUploader::Stats textures;
+    };
+
+    explicit AssetStreamer(std::size_t uploadBudget = DEFAULT_UPLOAD_BUDGET,
+                           ThreadPool& pool = ThreadPool::shared());
+    // waits for imports still running on the pool
+    ~AssetStreamer();
+
+    AssetStreamer(const AssetStreamer&) = delete;
+    AssetStreamer& operator=(const AssetStreamer&) = delete;
+
+    ModelHandle load(const std::string& path, bool gamma = false,
+                     ImportOptions options = {});
+
+    // call once per frame on the render thread
+    void update();
+    // blocks until every model requested so far is resident or has failed,
+    // uploading without a budget
+    void finish();
+    bool idle() const;
+
+    const Stats& stats() const;
+
+   private:
+    // an import that finished on the pool, waiting for the render thread
+    struct Completed {
+        std::shared_ptr<StreamedModel> streamed;
+        ImportedModel imported;
+        bool gamma;
+        Completed* next;
+    };
+
+    std::size_t uploadBudget;
+    ThreadPool& pool;
+    // intrusive stack pushed to by the workers and emptied at once by the
+    // render thread, which then restores the completion order
+    std::atomic<Completed*> completed{nullptr};
+    std::atomic<std::size_t> importing{0};
+    // models taken off the queue with uploads left, oldest first
+    std::vector<std::shared_ptr<StreamedModel>> uploading;
+    // stages texture uploads so they don't block on the driver's copy
+    TextureUploader textureUploader;
+    Stats frameStats;
+
+    void push(Completed* done);
+    // moves finished imports over to uploading
+    void collect();
+    std::size_t uploadPending(std::size_t byteBudget);
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // ASSET_STREAMER_H
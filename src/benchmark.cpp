@@ -0,0 +1,248 @@
+// clang-format off
+#include <glad/glad.h>
+#include "stb_image.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "headless_context.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "scene.h"
+// clang-format on
+
+// Headless benchmark: renders a scene offscreen along a fixed camera path and
+// prints the timings as JSON, e.g.
+//
+//   benchmark --scene asteroids --frames 600 --output result.json
+//
+// Run it from the repository root, like the app. Every run draws exactly the
+// same frames: the camera moves a fixed step per frame, not per second.
+
+using namespace personal::renderer;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string scene{"asteroids"};
+    int frames{600};
+    // frames rendered before measuring, to let drivers and caches settle
+    int warmup{30};
+    int width{1280};
+    int height{720};
+    // screen space error allowed for levels of detail, see Scene
+    float lodError{1.0f};
+    // cull the asteroids on the GPU where GL 4.3 allows, see Scene
+    bool gpuCulling{true};
+    std::string output;
+    std::string trace;
+};
+
+void printUsage() {
+    std::cout << "usage: benchmark [--scene name] [--frames n] [--warmup n]"
+                 " [--width n] [--height n] [--lod-error pixels]"
+                 " [--culling cpu|gpu]"
+                 " [--output file.json]"
+                 " [--trace trace.json]\nscenes:";
+    for (const std::string& name : utility::Scene::names())
+        std::cout << ' ' << name;
+    std::cout << '\n';
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* argument = argv[i];
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+
+        if (!std::strcmp(argument, "--scene"))
+            options.scene = value;
+        else if (!std::strcmp(argument, "--frames"))
+            options.frames = std::atoi(value);
+        else if (!std::strcmp(argument, "--warmup"))
+            options.warmup = std::atoi(value);
+        else if (!std::strcmp(argument, "--width"))
+            options.width = std::atoi(value);
+        else if (!std::strcmp(argument, "--height"))
+            options.height = std::atoi(value);
+        else if (!std::strcmp(argument, "--lod-error"))
+            options.lodError = static_cast<float>(std::atof(value));
+        else if (!std::strcmp(argument, "--culling") &&
+                 (!std::strcmp(value, "cpu") || !std::strcmp(value, "gpu")))
+            options.gpuCulling = !std::strcmp(value, "gpu");
+        else if (!std::strcmp(argument, "--output"))
+            options.output = value;
+        else if (!std::strcmp(argument, "--trace"))
+            options.trace = value;
+        else
+            return false;
+    }
+    return options.frames > 0 && options.warmup >= 0 && options.width > 0 &&
+           options.height > 0 && options.lodError >= 0.0f;
+}
+
+// one lap along the asteroid belt, bobbing up and down through it, looking
+// ahead along the ring with the planet off to the side
+glm::mat4 cameraPath(int frame, int frameCount) {
+    const float RADIUS = 155.0f;
+    float angle = glm::radians(360.0f * static_cast<float>(frame) /
+                               static_cast<float>(frameCount));
+    glm::vec3 position(std::sin(angle) * RADIUS,
+                       std::sin(angle * 3.0f) * 10.0f,
+                       std::cos(angle) * RADIUS);
+    glm::vec3 ahead(std::cos(angle), 0.0f, -std::sin(angle));
+    return glm::lookAt(position, position + ahead + glm::vec3(0.0f, -0.1f, 0.0f),
+                       glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+double milliseconds(Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// text as a quoted JSON string, escaping quotes, backslashes and control
+// characters
+std::string jsonString(const std::string& text) {
+    std::string result = "\"";
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (byte < 0x20) {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", byte);
+            result += escape;
+        } else {
+            result += c;
+        }
+    }
+    return result + '"';
+}
+
+void writeSummary(std::ostream& stream, const char* name,
+                  const utility::Profiler::Summary& summary) {
+    stream << "  \"" << name << "\": {\"mean\": " << summary.average
+           << ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95
+           << ", \"p99\": " << summary.p99 << "},\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    utility::HeadlessContext context(options.width, options.height);
+    if (!context.valid()) return EXIT_FAILURE;
+
+    glEnable(GL_DEPTH_TEST);
+    stbi_set_flip_vertically_on_load(true);
+
+    Clock::time_point loadBegin = Clock::now();
+    std::unique_ptr<utility::Scene> scene = utility::Scene::load(options.scene);
+    if (!scene) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+    scene->lodPixelError = options.lodError;
+    scene->gpuCulling = scene->gpuCulling && options.gpuCulling;
+    // measure everything resident, not just the first frames
+    scene->finishLoading();
+    glFinish();
+    double loadTime = milliseconds(Clock::now() - loadBegin);
+
+    glm::mat4 projection = glm::perspective(
+        glm::radians(45.0f),
+        static_cast<float>(options.width) / static_cast<float>(options.height),
+        0.1f, utility::SCENE_FAR_PLANE);
+
+    // frame times include waiting for the GPU, so a frame's cost can't hide
+    // in the next one
+    utility::Profiler profiler;
+    std::vector<double> frameTimes;
+    frameTimes.reserve(static_cast<std::size_t>(options.frames));
+    double drawCalls = 0.0;
+    double triangles = 0.0;
+    double visible = 0.0;
+    double promoted = 0.0;
+    for (int frame = -options.warmup; frame < options.frames; ++frame) {
+        Clock::time_point frameBegin = Clock::now();
+        profiler.beginFrame();
+        {
+            utility::ProfileScope scope(profiler, "Clear");
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+        int step = frame < 0 ? frame + options.warmup : frame;
+        scene->render(cameraPath(step, options.frames), projection,
+                      static_cast<float>(options.height), profiler);
+        profiler.endFrame();
+        glFinish();
+
+        if (frame < 0) continue;
+        frameTimes.push_back(milliseconds(Clock::now() - frameBegin));
+        drawCalls += static_cast<double>(scene->drawStats().drawCalls);
+        triangles += static_cast<double>(scene->drawStats().triangles);
+        visible += static_cast<double>(scene->cullingStats().visible);
+        promoted += static_cast<double>(scene->cullingStats().promoted);
+    }
+
+    if (!options.trace.empty()) profiler.writeChromeTrace(options.trace);
+
+    const char* renderer =
+        reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    double frameCount = static_cast<double>(options.frames);
+
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output, std::ios::trunc);
+        if (!file) {
+            std::cout << "ERROR::BENCHMARK::FILE_NOT_WRITABLE: "
+                      << options.output << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    std::ostream& stream = options.output.empty() ? std::cout : file;
+
+    stream << std::fixed;
+    stream.precision(3);
+    stream << "{\n"
+           << "  \"scene\": " << jsonString(options.scene) << ",\n"
+           << "  \"renderer\": "
+           << jsonString(renderer ? renderer : "unknown") << ",\n"
+           << "  \"width\": " << options.width << ",\n"
+           << "  \"height\": " << options.height << ",\n"
+           << "  \"frames\": " << options.frames << ",\n"
+           << "  \"lod_error\": " << options.lodError << ",\n"
+           << "  \"gpu_culling\": "
+           << (scene->gpuCulling ? "true" : "false") << ",\n"
+           << "  \"load_ms\": " << loadTime << ",\n";
+    const utility::ProgramCache::Stats& programs =
+        utility::ProgramCache::shared().stats();
+    stream << "  \"program_cache\": {\"hits\": " << programs.hits
+           << ", \"misses\": " << programs.misses
+           << ", \"compile_ms\": " << programs.compileMilliseconds
+           << ", \"saved_ms\": " << programs.savedMilliseconds << "},\n";
+    writeSummary(stream, "frame_ms", utility::Profiler::summarize(frameTimes));
+    stream << "  \"draw_calls_per_frame\": " << drawCalls / frameCount << ",\n"
+           << "  \"triangles_per_frame\": " << triangles / frameCount << ",\n"
+           << "  \"visible_per_frame\": " << visible / frameCount << ",\n"
+           << "  \"promoted_per_frame\": " << promoted / frameCount << "\n"
+           << "}\n";
+    return stream ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,297 @@
+#include "block_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+namespace personal::renderer::utility {
+
+namespace {
+
+float srgbToLinear(float value) {
+    value /= 255.0f;
+    return value <= 0.04045f ? value / 12.92f
+                             : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float linearToSrgb(float value) {
+    value = std::clamp(value, 0.0f, 1.0f);
+    value = value <= 0.0031308f
+                ? value * 12.92f
+                : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return value * 255.0f;
+}
+
+unsigned char toByte(float value) {
+    return static_cast<unsigned char>(std::clamp(value, 0.0f, 255.0f) + 0.5f);
+}
+
+std::uint16_t packRGB565(const float colour[3]) {
+    auto quantize = [](float value, int maximum) {
+        return static_cast<std::uint16_t>(
+            std::clamp(value, 0.0f, 255.0f) * maximum / 255.0f + 0.5f);
+    };
+    return static_cast<std::uint16_t>(quantize(colour[0], 31) << 11 |
+                                      quantize(colour[1], 63) << 5 |
+                                      quantize(colour[2], 31));
+}
+
+void unpackRGB565(std::uint16_t packed, float colour[3]) {
+    int r = packed >> 11 & 31;
+    int g = packed >> 5 & 63;
+    int b = packed & 31;
+    colour[0] = static_cast<float>(r << 3 | r >> 2);
+    colour[1] = static_cast<float>(g << 2 | g >> 4);
+    colour[2] = static_cast<float>(b << 3 | b >> 2);
+}
+
+void writeLittleEndian(unsigned char* out, std::uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i)
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+// BC1 colour block in four colour mode (which BC3 always uses). The
+// endpoints are the extremes of the block along its principal axis.
+void encodeColourBlock(const unsigned char* rgba, unsigned char* out) {
+    float pixels[16][3];
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    float low[3] = {255.0f, 255.0f, 255.0f};
+    float high[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            pixels[i][c] = rgba[i * 4 + c];
+            mean[c] += pixels[i][c] / 16.0f;
+            low[c] = std::min(low[c], pixels[i][c]);
+            high[c] = std::max(high[c], pixels[i][c]);
+        }
+    }
+
+    float covariance[3][3] = {};
+    for (const float* pixel : pixels)
+        for (int a = 0; a < 3; ++a)
+            for (int b = 0; b < 3; ++b)
+                covariance[a][b] += (pixel[a] - mean[a]) * (pixel[b] - mean[b]);
+
+    // power iteration, starting along the bounding box diagonal
+    float axis[3] = {high[0] - low[0], high[1] - low[1], high[2] - low[2]};
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[3];
+        for (int a = 0; a < 3; ++a)
+            next[a] = covariance[a][0] * axis[0] +
+                      covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] +
+                                 next[2] * next[2]);
+        if (length < 1e-6f) break;
+        for (int a = 0; a < 3; ++a) axis[a] = next[a] / length;
+    }
+    float axisLength =
+        std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    if (axisLength > 1e-6f)
+        for (float& a : axis) a /= axisLength;
+
+    float minimum = 0.0f;
+    float maximum = 0.0f;
+    for (const float* pixel : pixels) {
+        float t = (pixel[0] - mean[0]) * axis[0] +
+                  (pixel[1] - mean[1]) * axis[1] +
+                  (pixel[2] - mean[2]) * axis[2];
+        minimum = std::min(minimum, t);
+        maximum = std::max(maximum, t);
+    }
+    float endpoint0[3];
+    float endpoint1[3];
+    for (int c = 0; c < 3; ++c) {
+        endpoint0[c] = mean[c] + axis[c] * maximum;
+        endpoint1[c] = mean[c] + axis[c] * minimum;
+    }
+
+    // four colour mode needs colour0 > colour1
+    std::uint16_t colour0 = packRGB565(endpoint0);
+    std::uint16_t colour1 = packRGB565(endpoint1);
+    if (colour0 < colour1) std::swap(colour0, colour1);
+
+    float palette[4][3];
+    unpackRGB565(colour0, palette[0]);
+    unpackRGB565(colour1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    std::uint32_t indices = 0;
+    if (colour0 != colour1) {
+        for (int i = 0; i < 16; ++i) {
+            std::uint32_t best = 0;
+            float bestDistance = 1e30f;
+            for (std::uint32_t p = 0; p < 4; ++p) {
+                float distance = 0.0f;
+                for (int c = 0; c < 3; ++c) {
+                    float d = pixels[i][c] - palette[p][c];
+                    distance += d * d;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    writeLittleEndian(out, colour0, 2);
+    writeLittleEndian(out + 2, colour1, 2);
+    writeLittleEndian(out + 4, indices, 4);
+}
+
+// BC4 block of one channel, in eight value mode
+void encodeChannelBlock(const unsigned char* rgba, int channel,
+                        unsigned char* out) {
+    int low = 255;
+    int high = 0;
+    for (int i = 0; i < 16; ++i) {
+        low = std::min<int>(low, rgba[i * 4 + channel]);
+        high = std::max<int>(high, rgba[i * 4 + channel]);
+    }
+
+    // steps from high (0) to low (7) mapped to their palette index
+    const std::uint64_t STEP_INDEX[8] = {0, 2, 3, 4, 5, 6, 7, 1};
+    std::uint64_t indices = 0;
+    if (high > low) {
+        for (int i = 0; i < 16; ++i) {
+            int value = rgba[i * 4 + channel];
+            int step = ((high - value) * 14 + (high - low)) / (2 * (high - low));
+            indices |= STEP_INDEX[step] << (3 * i);
+        }
+    }
+
+    out[0] = static_cast<unsigned char>(high);
+    out[1] = static_cast<unsigned char>(low);
+    writeLittleEndian(out + 2, indices, 6);
+}
+
+}  // namespace
+
+std::vector<MipLevel> generateMipChain(const unsigned char* rgba, int width,
+                                       int height, bool srgb) {
+    std::size_t pixelCount =
+        static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+    std::vector<MipLevel> levels;
+    levels.push_back({width, height,
+                      std::vector<unsigned char>(rgba, rgba + pixelCount * 4)});
+
+    // filter in float from level to level so rounding errors don't add up
+    float toLinear[256];
+    for (int i = 0; i < 256; ++i)
+        toLinear[i] = srgb ? srgbToLinear(static_cast<float>(i))
+                           : static_cast<float>(i);
+    std::vector<float> current(pixelCount * 4);
+    for (std::size_t i = 0; i < current.size(); ++i)
+        current[i] = i % 4 == 3 ? rgba[i] : toLinear[rgba[i]];
+
+    while (width > 1 || height > 1) {
+        int nextWidth = std::max(1, width / 2);
+        int nextHeight = std::max(1, height / 2);
+        std::vector<float> next(static_cast<std::size_t>(nextWidth) *
+                                static_cast<std::size_t>(nextHeight) * 4);
+        MipLevel level{nextWidth, nextHeight,
+                       std::vector<unsigned char>(next.size())};
+
+        for (int y = 0; y < nextHeight; ++y) {
+            for (int x = 0; x < nextWidth; ++x) {
+                // 2x2 box, clamped at the edges of odd sized levels
+                int x0 = std::min(2 * x, width - 1);
+                int x1 = std::min(2 * x + 1, width - 1);
+                int y0 = std::min(2 * y, height - 1);
+                int y1 = std::min(2 * y + 1, height - 1);
+                std::size_t out =
+                    (static_cast<std::size_t>(y) * nextWidth + x) * 4;
+                for (int c = 0; c < 4; ++c) {
+                    auto at = [&](int sx, int sy) {
+                        return current[(static_cast<std::size_t>(sy) * width +
+                                        sx) * 4 + c];
+                    };
+                    float value = (at(x0, y0) + at(x1, y0) + at(x0, y1) +
+                                   at(x1, y1)) * 0.25f;
+                    next[out + c] = value;
+                    level.rgba[out + c] = toByte(
+                        srgb && c != 3 ? linearToSrgb(value) : value);
+                }
+            }
+        }
+
+        levels.push_back(std::move(level));
+        current = std::move(next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    return levels;
+}
+
+std::vector<unsigned char> compressImage(const unsigned char* rgba, int width,
+                                         int height, BlockFormat format) {
+    if (format == BlockFormat::BC7) {
+        std::cout << "ERROR::BLOCK_COMPRESSION::UNSUPPORTED_FORMAT: "
+                  << blockFormatName(format) << '\n';
+        return {};
+    }
+
+    std::vector<unsigned char> blocks(levelSize(format, width, height));
+    unsigned char* out = blocks.data();
+    unsigned char block[16 * 4];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            // blocks hanging over the edge repeat the last row and column
+            for (int y = 0; y < 4; ++y) {
+                for (int x = 0; x < 4; ++x) {
+                    int sx = std::min(bx + x, width - 1);
+                    int sy = std::min(by + y, height - 1);
+                    const unsigned char* pixel =
+                        rgba + (static_cast<std::size_t>(sy) * width + sx) * 4;
+                    std::copy(pixel, pixel + 4, block + (y * 4 + x) * 4);
+                }
+            }
+
+            switch (format) {
+                case BlockFormat::BC1:
+                    encodeColourBlock(block, out);
+                    break;
+                case BlockFormat::BC3:
+                    encodeChannelBlock(block, 3, out);
+                    encodeColourBlock(block, out + 8);
+                    break;
+                case BlockFormat::BC4:
+                    encodeChannelBlock(block, 0, out);
+                    break;
+                case BlockFormat::BC5:
+                    encodeChannelBlock(block, 0, out);
+                    encodeChannelBlock(block, 1, out + 8);
+                    break;
+                case BlockFormat::BC7:
+                    break;
+            }
+            out += blockBytes(format);
+        }
+    }
+    return blocks;
+}
+
+CompressedImage compressTexture(const unsigned char* rgba, int width,
+                                int height, BlockFormat format, bool srgb) {
+    CompressedImage image;
+    image.format = format;
+    image.srgb = srgb;
+    for (const MipLevel& level :
+         generateMipChain(rgba, width, height, srgb)) {
+        std::vector<unsigned char> blocks =
+            compressImage(level.rgba.data(), level.width, level.height, format);
+        if (blocks.empty()) return CompressedImage{};
+
+        image.levels.push_back(
+            {level.width, level.height, image.storage.size(), blocks.size()});
+        image.storage.insert(image.storage.end(), blocks.begin(), blocks.end());
+    }
+    return image;
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,34 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <vector>
+
+#include "dds.h"
+
+namespace personal::renderer::utility {
+
+// One level of an RGBA8 mip chain
+struct MipLevel {
+    int width;
+    int height;
+    std::vector<unsigned char> rgba;
+};
+
+// builds the full mip chain of an RGBA8 image down to 1x1, the first level
+// being the image itself. With srgb, colour is averaged in linear space so
+// the smaller mips don't darken; alpha is always linear.
+std::vector<MipLevel> generateMipChain(const unsigned char* rgba, int width,
+                                       int height, bool srgb);
+
+// encodes an RGBA8 image into 4x4 blocks. BC1 ignores alpha, BC4 and BC5
+// take the red and red/green channels. BC7 isn't supported for encoding.
+std::vector<unsigned char> compressImage(const unsigned char* rgba, int width,
+                                         int height, BlockFormat format);
+
+// generates the mips and compresses all of them
+CompressedImage compressTexture(const unsigned char* rgba, int width,
+                                int height, BlockFormat format, bool srgb);
+
+}  // namespace personal::renderer::utility
+
+#endif  // BLOCK_COMPRESSION_H
@@ -0,0 +1,241 @@
+#include "culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "mesh.h"
+
+#if defined(__AVX__)
+#define CULLING_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+namespace personal::renderer::utility {
+
+glm::vec3 AABB::center() const { return (min + max) * 0.5f; }
+
+glm::vec3 AABB::extent() const { return (max - min) * 0.5f; }
+
+AABB computeBounds(const Vertex* vertices, std::size_t count) {
+    AABB bounds;
+    if (count == 0) return bounds;
+
+    bounds.min = vertices[0].position;
+    bounds.max = vertices[0].position;
+    for (std::size_t i = 1; i < count; ++i) {
+        bounds.min = glm::min(bounds.min, vertices[i].position);
+        bounds.max = glm::max(bounds.max, vertices[i].position);
+    }
+    return bounds;
+}
+
+BoundingSphere computeBoundingSphere(const Vertex* vertices,
+                                     std::size_t count, const AABB& bounds) {
+    BoundingSphere sphere;
+    sphere.center = bounds.center();
+
+    float radiusSquared = 0.0f;
+    for (std::size_t i = 0; i < count; ++i) {
+        glm::vec3 d = vertices[i].position - sphere.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+    }
+    sphere.radius = std::sqrt(radiusSquared);
+    return sphere;
+}
+
+AABB mergeBounds(const AABB& a, const AABB& b) {
+    return AABB{glm::min(a.min, b.min), glm::max(a.max, b.max)};
+}
+
+AABB transformBounds(const AABB& bounds, const glm::mat4& transform) {
+    glm::vec3 center = bounds.center();
+    glm::vec3 extent = bounds.extent();
+
+    glm::vec3 newCenter(transform[3][0], transform[3][1], transform[3][2]);
+    glm::vec3 newExtent(0.0f);
+    for (int row = 0; row < 3; ++row) {
+        for (int column = 0; column < 3; ++column) {
+            newCenter[row] += transform[column][row] * center[column];
+            newExtent[row] +=
+                std::fabs(transform[column][row]) * extent[column];
+        }
+    }
+    return AABB{newCenter - newExtent, newCenter + newExtent};
+}
+
+Frustum Frustum::fromMatrix(const glm::mat4& clip) {
+    // rows of the (column-major) clip matrix
+    glm::vec4 row[4];
+    for (int r = 0; r < 4; ++r)
+        row[r] = glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+
+    Frustum frustum;
+    frustum.planes[0] = row[3] + row[0];         // left
+    frustum.planes[1] = row[3] + row[0] * -1.0f;  // right
+    frustum.planes[2] = row[3] + row[1];         // bottom
+    frustum.planes[3] = row[3] + row[1] * -1.0f;  // top
+    frustum.planes[4] = row[3] + row[2];         // near
+    frustum.planes[5] = row[3] + row[2] * -1.0f;  // far
+
+    for (glm::vec4& plane : frustum.planes) {
+        float length =
+            std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.0f) plane = plane * (1.0f / length);
+    }
+    return frustum;
+}
+
+void BoundsSoA::clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+}
+
+void BoundsSoA::reserve(std::size_t count) {
+    centerX.reserve(count);
+    centerY.reserve(count);
+    centerZ.reserve(count);
+    extentX.reserve(count);
+    extentY.reserve(count);
+    extentZ.reserve(count);
+}
+
+void BoundsSoA::resize(std::size_t count) {
+    centerX.resize(count);
+    centerY.resize(count);
+    centerZ.resize(count);
+    extentX.resize(count);
+    extentY.resize(count);
+    extentZ.resize(count);
+}
+
+void BoundsSoA::push(const AABB& bounds) {
+    resize(size() + 1);
+    set(size() - 1, bounds);
+}
+
+void BoundsSoA::set(std::size_t index, const AABB& bounds) {
+    glm::vec3 center = bounds.center();
+    glm::vec3 extent = bounds.extent();
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    extentX[index] = extent.x;
+    extentY[index] = extent.y;
+    extentZ[index] = extent.z;
+}
+
+std::size_t BoundsSoA::size() const { return centerX.size(); }
+
+void CullingStats::reset() {
+    tested = 0;
+    visible = 0;
+    promoted = 0;
+}
+
+void cullBounds(const Frustum& frustum, const BoundsSoA& bounds,
+                std::vector<unsigned int>& visible, CullingStats& stats) {
+    cullBounds(frustum, bounds, 0, bounds.size(), visible, stats);
+}
+
+void cullBounds(const Frustum& frustum, const BoundsSoA& bounds,
+                std::size_t first, std::size_t count,
+                std::vector<unsigned int>& visible, CullingStats& stats) {
+    const std::size_t end = first + count;
+    const std::size_t visibleBefore = visible.size();
+    std::size_t i = first;
+
+    // a box is outside as soon as it lies entirely behind one plane:
+    // dot(n, c) + d + dot(|n|, e) < 0
+
+#if defined(CULLING_AVX)
+    for (; i + 8 <= end; i += 8) {
+        __m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+        __m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+        __m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+        __m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+        __m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+        __m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+
+        __m256 outside = _mm256_setzero_ps();
+        for (const glm::vec4& plane : frustum.planes) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane.x)),
+                              _mm256_mul_ps(cy, _mm256_set1_ps(plane.y))),
+                _mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(plane.z)),
+                              _mm256_set1_ps(plane.w)));
+            __m256 radius = _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(ex, _mm256_set1_ps(std::fabs(plane.x))),
+                    _mm256_mul_ps(ey, _mm256_set1_ps(std::fabs(plane.y)))),
+                _mm256_mul_ps(ez, _mm256_set1_ps(std::fabs(plane.z))));
+            outside = _mm256_or_ps(
+                outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius),
+                                       _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+
+        int mask = ~_mm256_movemask_ps(outside) & 0xff;
+        for (unsigned int lane = 0; mask; ++lane, mask >>= 1)
+            if (mask & 1) visible.push_back(static_cast<unsigned int>(i + lane));
+    }
+#elif defined(CULLING_SSE)
+    for (; i + 4 <= end; i += 4) {
+        __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+        __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+        __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+        __m128 outside = _mm_setzero_ps();
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 distance =
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)),
+                                      _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                           _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)),
+                                      _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(std::fabs(plane.x))),
+                           _mm_mul_ps(ey, _mm_set1_ps(std::fabs(plane.y)))),
+                _mm_mul_ps(ez, _mm_set1_ps(std::fabs(plane.z))));
+            outside = _mm_or_ps(
+                outside,
+                _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        int mask = ~_mm_movemask_ps(outside) & 0xf;
+        for (unsigned int lane = 0; mask; ++lane, mask >>= 1)
+            if (mask & 1) visible.push_back(static_cast<unsigned int>(i + lane));
+    }
+#endif
+
+    // scalar path for the remainder, or everything without SIMD support
+    for (; i < end; ++i) {
+        bool inside = true;
+        for (const glm::vec4& plane : frustum.planes) {
+            float distance = plane.x * bounds.centerX[i] +
+                             plane.y * bounds.centerY[i] +
+                             plane.z * bounds.centerZ[i] + plane.w;
+            float radius = std::fabs(plane.x) * bounds.extentX[i] +
+                           std::fabs(plane.y) * bounds.extentY[i] +
+                           std::fabs(plane.z) * bounds.extentZ[i];
+            if (distance + radius < 0.0f) {
+                inside = false;
+                break;
+            }
+        }
+        if (inside) visible.push_back(static_cast<unsigned int>(i));
+    }
+
+    stats.tested += count;
+    stats.visible += visible.size() - visibleBefore;
+}
+
+}  // namespace personal::renderer::utility
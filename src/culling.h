@@ -0,0 +1,81 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace personal::renderer::utility {
+
+struct Vertex;
+
+struct AABB {
+    glm::vec3 min{0.0f};
+    glm::vec3 max{0.0f};
+
+    glm::vec3 center() const;
+    glm::vec3 extent() const;
+};
+
+struct BoundingSphere {
+    glm::vec3 center{0.0f};
+    float radius{0.0f};
+};
+
+AABB computeBounds(const Vertex* vertices, std::size_t count);
+// sphere around the box centre enclosing every vertex
+BoundingSphere computeBoundingSphere(const Vertex* vertices,
+                                     std::size_t count, const AABB& bounds);
+AABB mergeBounds(const AABB& a, const AABB& b);
+// box enclosing the transformed box (Arvo's method)
+AABB transformBounds(const AABB& bounds, const glm::mat4& transform);
+
+// The six clip planes of a view frustum as (normal, distance) with normals
+// pointing inwards. Extracted from a clip matrix (Gribb & Hartmann), so
+// projection * view gives world space planes and projection * view * model
+// gives planes in that model's space.
+struct Frustum {
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4& clip);
+};
+
+// Bounding boxes stored as separate centre and extent arrays, so the culling
+// loop can load four (SSE) or eight (AVX) boxes per instruction
+class BoundsSoA {
+   public:
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+
+    void clear();
+    void reserve(std::size_t count);
+    void resize(std::size_t count);
+    void push(const AABB& bounds);
+    void set(std::size_t index, const AABB& bounds);
+    std::size_t size() const;
+};
+
+struct CullingStats {
+    std::size_t tested{0};
+    std::size_t visible{0};
+    // visible instances drawn at a finer level than the one selected for
+    // them, see InstancedModel::submit()
+    std::size_t promoted{0};
+
+    void reset();
+};
+
+// Appends the index of every box that intersects the frustum to visible, in
+// increasing order, and adds to stats. The test is conservative: boxes near a
+// frustum corner may be reported visible when they aren't.
+void cullBounds(const Frustum& frustum, const BoundsSoA& bounds,
+                std::vector<unsigned int>& visible, CullingStats& stats);
+// the same for the count boxes from first on, so that separate ranges can be
+// culled in parallel
+void cullBounds(const Frustum& frustum, const BoundsSoA& bounds,
+                std::size_t first, std::size_t count,
+                std::vector<unsigned int>& visible, CullingStats& stats);
+
+}  // namespace personal::renderer::utility
+
+#endif  // CULLING_H
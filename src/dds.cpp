@@ -0,0 +1,279 @@
+#include "dds.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace personal::renderer::utility {
+
+namespace {
+
+const std::uint32_t MAGIC = 0x20534444;  // "DDS "
+
+// part of the cooked file name, so a change to what the cooker writes makes
+// the loaders ignore old files until they are cooked again. 2: rows bottom
+// first, matching the loaders' flipped stb_image decode.
+const char* const COOKED_SUFFIX = ".v2.dds";
+
+const std::uint32_t DDSD_CAPS = 0x1;
+const std::uint32_t DDSD_HEIGHT = 0x2;
+const std::uint32_t DDSD_WIDTH = 0x4;
+const std::uint32_t DDSD_PIXELFORMAT = 0x1000;
+const std::uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+const std::uint32_t DDSD_LINEARSIZE = 0x80000;
+const std::uint32_t DDPF_FOURCC = 0x4;
+const std::uint32_t DDSCAPS_COMPLEX = 0x8;
+const std::uint32_t DDSCAPS_TEXTURE = 0x1000;
+const std::uint32_t DDSCAPS_MIPMAP = 0x400000;
+const std::uint32_t DIMENSION_TEXTURE2D = 3;
+
+struct PixelFormat {
+    std::uint32_t size;
+    std::uint32_t flags;
+    std::uint32_t fourCC;
+    std::uint32_t rgbBitCount;
+    std::uint32_t bitMasks[4];
+};
+
+struct Header {
+    std::uint32_t size;
+    std::uint32_t flags;
+    std::uint32_t height;
+    std::uint32_t width;
+    std::uint32_t pitchOrLinearSize;
+    std::uint32_t depth;
+    std::uint32_t mipMapCount;
+    std::uint32_t reserved1[11];
+    PixelFormat pixelFormat;
+    std::uint32_t caps;
+    std::uint32_t caps2;
+    std::uint32_t caps3;
+    std::uint32_t caps4;
+    std::uint32_t reserved2;
+};
+
+struct HeaderDX10 {
+    std::uint32_t dxgiFormat;
+    std::uint32_t resourceDimension;
+    std::uint32_t miscFlag;
+    std::uint32_t arraySize;
+    std::uint32_t miscFlags2;
+};
+
+static_assert(sizeof(Header) == 124, "DDS header must be 124 bytes");
+
+constexpr std::uint32_t fourCC(char a, char b, char c, char d) {
+    return static_cast<std::uint32_t>(a) |
+           static_cast<std::uint32_t>(b) << 8 |
+           static_cast<std::uint32_t>(c) << 16 |
+           static_cast<std::uint32_t>(d) << 24;
+}
+
+// DXGI_FORMAT values of the block formats, UNORM and UNORM_SRGB
+struct DxgiFormat {
+    BlockFormat format;
+    std::uint32_t unorm;
+    std::uint32_t srgb;
+};
+
+const DxgiFormat DXGI_FORMATS[] = {{BlockFormat::BC1, 71, 72},
+                                   {BlockFormat::BC3, 77, 78},
+                                   {BlockFormat::BC4, 80, 80},
+                                   {BlockFormat::BC5, 83, 83},
+                                   {BlockFormat::BC7, 98, 99}};
+
+bool fromDxgi(std::uint32_t dxgi, BlockFormat& format, bool& srgb) {
+    for (const DxgiFormat& entry : DXGI_FORMATS) {
+        if (dxgi == entry.unorm || dxgi == entry.srgb) {
+            format = entry.format;
+            srgb = dxgi == entry.srgb && entry.srgb != entry.unorm;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::uint32_t toDxgi(BlockFormat format, bool srgb) {
+    for (const DxgiFormat& entry : DXGI_FORMATS)
+        if (entry.format == format) return srgb ? entry.srgb : entry.unorm;
+    return 0;
+}
+
+bool fromFourCC(std::uint32_t code, BlockFormat& format) {
+    if (code == fourCC('D', 'X', 'T', '1'))
+        format = BlockFormat::BC1;
+    else if (code == fourCC('D', 'X', 'T', '5'))
+        format = BlockFormat::BC3;
+    else if (code == fourCC('A', 'T', 'I', '1') ||
+             code == fourCC('B', 'C', '4', 'U'))
+        format = BlockFormat::BC4;
+    else if (code == fourCC('A', 'T', 'I', '2') ||
+             code == fourCC('B', 'C', '5', 'U'))
+        format = BlockFormat::BC5;
+    else
+        return false;
+    return true;
+}
+
+}  // namespace
+
+const char* blockFormatName(BlockFormat format) {
+    switch (format) {
+        case BlockFormat::BC1:
+            return "BC1";
+        case BlockFormat::BC3:
+            return "BC3";
+        case BlockFormat::BC4:
+            return "BC4";
+        case BlockFormat::BC5:
+            return "BC5";
+        case BlockFormat::BC7:
+            return "BC7";
+    }
+    return "unknown";
+}
+
+std::size_t blockBytes(BlockFormat format) {
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+std::size_t levelSize(BlockFormat format, int width, int height) {
+    std::size_t blocksWide =
+        static_cast<std::size_t>(std::max(1, (width + 3) / 4));
+    std::size_t blocksHigh =
+        static_cast<std::size_t>(std::max(1, (height + 3) / 4));
+    return blocksWide * blocksHigh * blockBytes(format);
+}
+
+bool CompressedImage::empty() const { return levels.empty(); }
+
+const unsigned char* CompressedImage::data(std::size_t level) const {
+    const unsigned char* base = file ? file->data() : storage.data();
+    return base + levels[level].offset;
+}
+
+std::size_t CompressedImage::totalSize() const {
+    std::size_t total = 0;
+    for (const Level& level : levels) total += level.size;
+    return total;
+}
+
+std::string cookedPath(const std::string& sourcePath) {
+    return sourcePath + COOKED_SUFFIX;
+}
+
+bool readCookedTexture(const std::string& sourcePath, CompressedImage& image) {
+    std::string path = cookedPath(sourcePath);
+    std::error_code error;
+    auto cookedTime = std::filesystem::last_write_time(path, error);
+    if (error) return false;
+    auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+    // a stale cooked file is ignored until the cooker runs again
+    if (!error && sourceTime > cookedTime) return false;
+
+    return readDDS(path, image);
+}
+
+bool readDDS(const std::string& path, CompressedImage& image) {
+    auto file = std::make_shared<MappedFile>(path);
+    if (!file->isOpen()) return false;
+
+    const unsigned char* data = file->data();
+    std::size_t size = file->size();
+    std::uint32_t magic;
+    Header header;
+    if (size < sizeof(magic) + sizeof(header)) return false;
+    std::memcpy(&magic, data, sizeof(magic));
+    std::memcpy(&header, data + sizeof(magic), sizeof(header));
+    std::size_t offset = sizeof(magic) + sizeof(header);
+
+    BlockFormat format;
+    bool srgb = false;
+    bool known = false;
+    if (magic == MAGIC && header.size == sizeof(Header) &&
+        header.pixelFormat.flags & DDPF_FOURCC) {
+        if (header.pixelFormat.fourCC == fourCC('D', 'X', '1', '0')) {
+            HeaderDX10 dx10;
+            if (size >= offset + sizeof(dx10)) {
+                std::memcpy(&dx10, data + offset, sizeof(dx10));
+                offset += sizeof(dx10);
+                known = dx10.resourceDimension == DIMENSION_TEXTURE2D &&
+                        dx10.arraySize <= 1 &&
+                        fromDxgi(dx10.dxgiFormat, format, srgb);
+            }
+        } else {
+            known = fromFourCC(header.pixelFormat.fourCC, format);
+        }
+    }
+    if (!known || header.width == 0 || header.height == 0) {
+        std::cout << "ERROR::DDS::UNSUPPORTED_FORMAT: " << path << '\n';
+        return false;
+    }
+
+    CompressedImage result;
+    result.format = format;
+    result.srgb = srgb;
+    int width = static_cast<int>(header.width);
+    int height = static_cast<int>(header.height);
+    std::uint32_t levelCount =
+        header.flags & DDSD_MIPMAPCOUNT ? std::max(header.mipMapCount, 1u) : 1;
+    for (std::uint32_t i = 0; i < levelCount; ++i) {
+        std::size_t bytes = levelSize(format, width, height);
+        if (offset + bytes > size) {
+            std::cout << "ERROR::DDS::TRUNCATED_FILE: " << path << '\n';
+            return false;
+        }
+        result.levels.push_back({width, height, offset, bytes});
+        offset += bytes;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    result.file = std::move(file);
+    image = std::move(result);
+    return true;
+}
+
+bool writeDDS(const std::string& path, const CompressedImage& image) {
+    if (image.empty()) return false;
+
+    const CompressedImage::Level& top = image.levels.front();
+    Header header{};
+    header.size = sizeof(Header);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+                   DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header.height = static_cast<std::uint32_t>(top.height);
+    header.width = static_cast<std::uint32_t>(top.width);
+    header.pitchOrLinearSize = static_cast<std::uint32_t>(top.size);
+    header.mipMapCount = static_cast<std::uint32_t>(image.levels.size());
+    header.pixelFormat.size = sizeof(PixelFormat);
+    header.pixelFormat.flags = DDPF_FOURCC;
+    header.pixelFormat.fourCC = fourCC('D', 'X', '1', '0');
+    header.caps = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+    HeaderDX10 dx10{};
+    dx10.dxgiFormat = toDxgi(image.format, image.srgb);
+    dx10.resourceDimension = DIMENSION_TEXTURE2D;
+    dx10.arraySize = 1;
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+        std::cout << "ERROR::DDS::FILE_NOT_WRITABLE: " << path << '\n';
+        return false;
+    }
+    stream.write(reinterpret_cast<const char*>(&MAGIC), sizeof(MAGIC));
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(&dx10), sizeof(dx10));
+    for (std::size_t i = 0; i < image.levels.size(); ++i)
+        stream.write(reinterpret_cast<const char*>(image.data(i)),
+                     static_cast<std::streamsize>(image.levels[i].size));
+
+    if (!stream) {
+        std::cout << "ERROR::DDS::WRITE_FAILED: " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,62 @@
+#ifndef DDS_H
+#define DDS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+namespace personal::renderer::utility {
+
+// GPU block compression formats. BC1 is opaque RGB at 4 bits per pixel, BC3
+// RGBA at 8, BC4 and BC5 one and two linear channels (e.g. normal maps) at 4
+// and 8, BC7 high quality RGBA at 8.
+enum class BlockFormat : std::uint32_t { BC1, BC3, BC4, BC5, BC7 };
+
+const char* blockFormatName(BlockFormat format);
+// bytes per 4x4 block
+std::size_t blockBytes(BlockFormat format);
+std::size_t levelSize(BlockFormat format, int width, int height);
+
+// A block-compressed texture with its whole mip chain, as stored in a DDS
+// file. Level data lives either in the mapped file it was read from or in
+// storage.
+struct CompressedImage {
+    struct Level {
+        int width;
+        int height;
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    BlockFormat format{BlockFormat::BC1};
+    // whether the colour is sRGB encoded (and its mips were filtered in
+    // linear space)
+    bool srgb{false};
+    std::vector<Level> levels;
+    std::shared_ptr<MappedFile> file;
+    std::vector<unsigned char> storage;
+
+    bool empty() const;
+    const unsigned char* data(std::size_t level) const;
+    std::size_t totalSize() const;
+};
+
+// where the texture cooker puts the cooked version of a source image, named
+// after the version of the cooked format
+std::string cookedPath(const std::string& sourcePath);
+// reads the cooked version of a source image, if there is one at least as
+// new as the source
+bool readCookedTexture(const std::string& sourcePath, CompressedImage& image);
+
+// reads a DDS file with a DX10 header, or a legacy DXT1/DXT5/ATI1/ATI2 one.
+// The levels are read in place from the mapped file.
+bool readDDS(const std::string& path, CompressedImage& image);
+bool writeDDS(const std::string& path, const CompressedImage& image);
+
+}  // namespace personal::renderer::utility
+
+#endif  // DDS_H
@@ -0,0 +1,190 @@
+#include "frame_pacer.h"
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "imgui.h"
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// how long before its slot the limiter stops sleeping and spins instead
+const std::chrono::microseconds SPIN_MARGIN{2000};
+// how long a single wait for the GPU may block, in nanoseconds, before it is
+// retried
+const GLuint64 WAIT_TIMEOUT = 1000000;
+
+double milliseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+bool signaled(GLsync fence) {
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+}  // namespace
+
+FramePacer::FramePacer()
+    : adaptive(glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+               glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+    latencies.reserve(LATENCY_SAMPLES);
+    setSwapMode(SwapMode::VSync);
+}
+
+FramePacer::~FramePacer() {
+    for (InFlight& frame : frames) {
+        if (frame.fence) glDeleteSync(frame.fence);
+        if (frame.query) glDeleteQueries(1, &frame.query);
+    }
+}
+
+void FramePacer::setSwapMode(SwapMode requested) {
+    if (requested == SwapMode::AdaptiveVSync && !adaptive)
+        requested = SwapMode::VSync;
+    mode = requested;
+    switch (mode) {
+        case SwapMode::Immediate:
+            glfwSwapInterval(0);
+            break;
+        case SwapMode::VSync:
+            glfwSwapInterval(1);
+            break;
+        case SwapMode::AdaptiveVSync:
+            // negative intervals tear late frames
+            glfwSwapInterval(-1);
+            break;
+    }
+}
+
+SwapMode FramePacer::swapMode() const { return mode; }
+
+bool FramePacer::adaptiveSupported() const { return adaptive; }
+
+void FramePacer::beginFrame() {
+    framesInFlight =
+        std::clamp<std::size_t>(framesInFlight, 1, MAX_FRAMES_IN_FLIGHT);
+
+    // the frame framesInFlight frames back has to be done before this one
+    // starts. Fences signal in order, so everything before it is done too.
+    Clock::time_point begin = Clock::now();
+    InFlight& oldest = frames[(frameIndex + MAX_FRAMES_IN_FLIGHT -
+                               framesInFlight) %
+                              MAX_FRAMES_IN_FLIGHT];
+    if (oldest.fence && !signaled(oldest.fence)) {
+        while (glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                WAIT_TIMEOUT) == GL_TIMEOUT_EXPIRED) {
+        }
+    }
+    frameStats.runAheadMilliseconds = milliseconds(Clock::now() - begin);
+
+    bool resolved = false;
+    for (InFlight& frame : frames) {
+        if (!frame.fence || !signaled(frame.fence)) continue;
+        resolve(frame);
+        resolved = true;
+    }
+    if (resolved) frameStats.latency = Profiler::summarize(latencies);
+
+    limitFrameRate();
+
+    Clock::time_point now = Clock::now();
+    if (lastBegin != Clock::time_point{})
+        frameStats.frameMilliseconds = milliseconds(now - lastBegin);
+    lastBegin = now;
+
+    glGetInteger64v(GL_TIMESTAMP, &gpuReference);
+    cpuReference = Clock::now();
+}
+
+void FramePacer::latchInput() {
+    glfwPollEvents();
+    latched = Clock::now();
+}
+
+void FramePacer::endFrame() {
+    InFlight& frame = frames[frameIndex];
+    // beginFrame() resolved it already, unless framesInFlight changed
+    if (frame.fence) resolve(frame);
+    if (!frame.query) glGenQueries(1, &frame.query);
+    glQueryCounter(frame.query, GL_TIMESTAMP);
+    frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame.latched = latched;
+    frameIndex = (frameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+void FramePacer::drawImGui() {
+    ImGui::Begin("Frame pacing");
+
+    const char* const modes[] = {"Off", "VSync", "Adaptive VSync"};
+    int selected = static_cast<int>(mode);
+    if (ImGui::Combo("Swap", &selected, modes, adaptive ? 3 : 2))
+        setSwapMode(static_cast<SwapMode>(selected));
+    ImGui::SliderFloat("Frame limit (0 = off)", &frameRateLimit, 0.0f,
+                       240.0f);
+    int inFlight = static_cast<int>(framesInFlight);
+    if (ImGui::SliderInt("Frames in flight", &inFlight, 1,
+                         static_cast<int>(MAX_FRAMES_IN_FLIGHT)))
+        framesInFlight = static_cast<std::size_t>(inFlight);
+    ImGui::Checkbox("Late input latching", &lateLatch);
+
+    ImGui::Separator();
+    ImGui::Text("Frame: %.2f ms, waited %.2f ms limiter, %.2f ms GPU",
+                frameStats.frameMilliseconds, frameStats.limiterMilliseconds,
+                frameStats.runAheadMilliseconds);
+    const Profiler::Summary& latency = frameStats.latency;
+    ImGui::Text("Input to swap: %.2f ms avg, %.2f p50, %.2f p95, %.2f p99",
+                latency.average, latency.p50, latency.p95, latency.p99);
+
+    ImGui::End();
+}
+
+const FramePacer::Stats& FramePacer::stats() const { return frameStats; }
+
+void FramePacer::resolve(InFlight& frame) {
+    // the fence follows the query, so its result is ready
+    GLuint64 swapped = 0;
+    glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &swapped);
+    glDeleteSync(frame.fence);
+    frame.fence = nullptr;
+    if (frame.latched == Clock::time_point{}) return;
+
+    std::chrono::nanoseconds sinceReference(static_cast<GLint64>(swapped) -
+                                            gpuReference);
+    Clock::time_point swapTime =
+        cpuReference +
+        std::chrono::duration_cast<Clock::duration>(sinceReference);
+    double latency = milliseconds(swapTime - frame.latched);
+    if (latencies.size() < LATENCY_SAMPLES) {
+        latencies.push_back(latency);
+    } else {
+        latencies[nextLatency] = latency;
+        nextLatency = (nextLatency + 1) % LATENCY_SAMPLES;
+    }
+}
+
+void FramePacer::limitFrameRate() {
+    frameStats.limiterMilliseconds = 0.0;
+    if (frameRateLimit <= 0.0f) {
+        deadline = Clock::time_point{};
+        return;
+    }
+
+    Clock::time_point begin = Clock::now();
+    Clock::duration period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / frameRateLimit));
+    // the first limited frame, or one too late to catch up with its slot,
+    // starts a new schedule
+    if (deadline == Clock::time_point{} || begin > deadline + period)
+        deadline = begin;
+    if (deadline - begin > SPIN_MARGIN)
+        std::this_thread::sleep_until(deadline - SPIN_MARGIN);
+    while (Clock::now() < deadline) std::this_thread::yield();
+    deadline += period;
+    frameStats.limiterMilliseconds = milliseconds(Clock::now() - begin);
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,121 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+#include "profiler.h"
+
+namespace personal::renderer::utility {
+
+enum class SwapMode {
+    // swap as soon as the frame is done, tearing
+    Immediate,
+    // wait for vertical blank
+    VSync,
+    // wait for vertical blank unless the frame is late for it, then swap
+    // right away and tear. Needs EXT_swap_control_tear, otherwise VSync.
+    AdaptiveVSync
+};
+
+// Paces the render loop and measures its input latency.
+//
+// beginFrame() keeps the CPU at most framesInFlight frames ahead of the GPU,
+// waiting on a fence placed after each frame's swap, and then holds the frame
+// back to frameRateLimit: it sleeps until shortly before the frame's slot and
+// spins through the rest, since sleeps overshoot by up to a scheduler tick.
+// Waiting before input is read rather than after means the wait doesn't age
+// the input.
+//
+// latchInput() polls window events and marks when the frame's input was
+// read. With lateLatch the loop calls it right before the camera matrices are
+// computed and written to the uniform ring; otherwise once after the swap,
+// as the loop used to. The latency is measured from there until the GPU
+// executes the frame's swap, with a timestamp query issued after it. With
+// vsync the image may still wait for the vertical blank after that.
+//
+// Has to be used on the thread owning the GL context.
+class FramePacer {
+   public:
+    static const std::size_t MAX_FRAMES_IN_FLIGHT = 3;
+    // frames kept for the latency statistics
+    static const std::size_t LATENCY_SAMPLES = 120;
+
+    struct Stats {
+        // time between the starts of the last two frames
+        double frameMilliseconds{0.0};
+        // how long the last frame waited for the limiter and for the GPU
+        double limiterMilliseconds{0.0};
+        double runAheadMilliseconds{0.0};
+        // input to swap, over the last LATENCY_SAMPLES frames
+        Profiler::Summary latency;
+    };
+
+    // frames per second to hold the loop to, 0 for no limit
+    float frameRateLimit{0.0f};
+    // frames the CPU may queue before waiting for the GPU, from 1 to
+    // MAX_FRAMES_IN_FLIGHT
+    std::size_t framesInFlight{2};
+    bool lateLatch{true};
+
+    // sets the VSync swap mode, so the context has to be current
+    FramePacer();
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    void setSwapMode(SwapMode mode);
+    SwapMode swapMode() const;
+    // whether the driver can tear late frames, see SwapMode::AdaptiveVSync
+    bool adaptiveSupported() const;
+
+    // waits until the frame may start, see the class comment
+    void beginFrame();
+    // polls window events and marks the time the frame's input was read
+    void latchInput();
+    // fences the frame and times its swap. Call right after swapping.
+    void endFrame();
+
+    // draws the "Frame pacing" window with the settings and statistics
+    void drawImGui();
+
+    const Stats& stats() const;
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    // a frame the GPU may still be working on
+    struct InFlight {
+        GLsync fence{nullptr};
+        unsigned int query{0};
+        Clock::time_point latched;
+    };
+
+    SwapMode mode{SwapMode::VSync};
+    bool adaptive{false};
+    InFlight frames[MAX_FRAMES_IN_FLIGHT];
+    std::size_t frameIndex{0};
+    Clock::time_point latched;
+    Clock::time_point lastBegin;
+    // the limiter's next frame slot, unset until the first limited frame
+    Clock::time_point deadline;
+    // a GL timestamp and the CPU time it was read at, to convert the
+    // timestamp queries
+    GLint64 gpuReference{0};
+    Clock::time_point cpuReference;
+    std::vector<double> latencies;
+    std::size_t nextLatency{0};
+    Stats frameStats;
+
+    // reads back the latency of a frame whose fence has signaled
+    void resolve(InFlight& frame);
+    void limitFrameRate();
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // FRAME_PACER_H
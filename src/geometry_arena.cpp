@@ -0,0 +1,117 @@
+#include "geometry_arena.h"
+
+#include <algorithm>
+
+namespace personal::renderer::utility {
+
+GeometryArena::GeometryArena(std::size_t vertexBytes, std::size_t indexBytes)
+    : vertexBytes(vertexBytes), indexBytes(indexBytes) {}
+
+GeometryArena::~GeometryArena() {
+    for (Pool& pool : pools) {
+        glDeleteVertexArrays(1, &pool.VAO);
+        glDeleteBuffers(1, &pool.VBO);
+        glDeleteBuffers(1, &pool.EBO);
+    }
+}
+
+GeometryRange GeometryArena::allocate(VertexFormat format, GLenum indexType,
+                                      const void* vertexData,
+                                      std::size_t vertexCount,
+                                      const void* indexData,
+                                      std::size_t indexCount) {
+    Pool& pool = poolFor(format, indexType);
+    std::size_t vertexDataSize = vertexCount * vertexSize(format);
+    std::size_t indexDataSize = indexCount * indexSize(indexType);
+
+    if (pool.vertexUsed + vertexDataSize > pool.vertexCapacity)
+        grow(pool, GL_ARRAY_BUFFER, pool.vertexUsed + vertexDataSize);
+    if (pool.indexUsed + indexDataSize > pool.indexCapacity)
+        grow(pool, GL_ELEMENT_ARRAY_BUFFER, pool.indexUsed + indexDataSize);
+
+    // a pool only ever holds one vertex format and index type, so the used
+    // sizes are always whole vertices and indices
+    GeometryRange range{
+        pool.VAO,
+        static_cast<int>(pool.vertexUsed / vertexSize(format)),
+        pool.indexUsed / indexSize(indexType)};
+
+    // upload through the copy target so the element array binding of
+    // whatever VAO is bound isn't touched
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool.VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, pool.vertexUsed, vertexDataSize,
+                    vertexData);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool.EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, pool.indexUsed, indexDataSize,
+                    indexData);
+
+    pool.vertexUsed += vertexDataSize;
+    pool.indexUsed += indexDataSize;
+    return range;
+}
+
+std::size_t GeometryArena::poolCount() const { return pools.size(); }
+
+std::size_t GeometryArena::usedBytes() const {
+    std::size_t used = 0;
+    for (const Pool& pool : pools) used += pool.vertexUsed + pool.indexUsed;
+    return used;
+}
+
+GeometryArena::Pool& GeometryArena::poolFor(VertexFormat format,
+                                            GLenum indexType) {
+    for (Pool& pool : pools)
+        if (pool.format == format && pool.indexType == indexType) return pool;
+
+    Pool pool{format, indexType, 0, 0, 0, vertexBytes, 0, indexBytes, 0};
+    glGenVertexArrays(1, &pool.VAO);
+    glGenBuffers(1, &pool.VBO);
+    glGenBuffers(1, &pool.EBO);
+
+    glBindVertexArray(pool.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, pool.VBO);
+    glBufferData(GL_ARRAY_BUFFER, pool.vertexCapacity, nullptr,
+                 GL_STATIC_DRAW);
+    setVertexAttributes(format);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, pool.indexCapacity, nullptr,
+                 GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    pools.push_back(pool);
+    return pools.back();
+}
+
+void GeometryArena::grow(Pool& pool, GLenum target, std::size_t required) {
+    bool vertices = target == GL_ARRAY_BUFFER;
+    unsigned int& buffer = vertices ? pool.VBO : pool.EBO;
+    std::size_t& capacity = vertices ? pool.vertexCapacity : pool.indexCapacity;
+    std::size_t used = vertices ? pool.vertexUsed : pool.indexUsed;
+
+    unsigned int newBuffer;
+    std::size_t newCapacity = std::max(required, capacity * 2);
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity, nullptr, GL_STATIC_DRAW);
+    if (used > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                            used);
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = newBuffer;
+    capacity = newCapacity;
+
+    // the VAO still points at the deleted buffer; the meshes only know the
+    // VAO, so they pick the new storage up without noticing
+    glBindVertexArray(pool.VAO);
+    if (vertices) {
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        setVertexAttributes(pool.format);
+    } else {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    }
+    glBindVertexArray(0);
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,76 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.h"
+
+namespace personal::renderer::utility {
+
+// Where a mesh's geometry ended up inside a GeometryArena
+struct GeometryRange {
+    unsigned int vertexArray;
+    int baseVertex;
+    std::size_t firstIndex;
+};
+
+// Suballocates the vertex and index data of static meshes from one large
+// VBO/EBO pair per vertex format and index type, each with a single VAO. Every
+// mesh in a pool shares the VAO, so drawing consecutive meshes doesn't switch
+// vertex arrays or buffers and can be merged into one
+// glMultiDrawElementsBaseVertex call (see Mesh::drawMulti). Indices stay
+// relative to the mesh, which is what lets 16-bit indexed meshes share a pool
+// holding far more than 65535 vertices.
+//
+// Allocations live as long as the arena; there is no freeing of single ranges.
+class GeometryArena {
+   public:
+    // initial sizes of each pool's buffers, in bytes. Pools double in size
+    // when they run out.
+    explicit GeometryArena(std::size_t vertexBytes = 16 * 1024 * 1024,
+                           std::size_t indexBytes = 4 * 1024 * 1024);
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // copies the vertex and index data, which must already be in the given
+    // format and index type, into the matching pool
+    GeometryRange allocate(VertexFormat format, GLenum indexType,
+                           const void* vertexData, std::size_t vertexCount,
+                           const void* indexData, std::size_t indexCount);
+
+    std::size_t poolCount() const;
+    // bytes in use across all pools
+    std::size_t usedBytes() const;
+
+   private:
+    struct Pool {
+        VertexFormat format;
+        GLenum indexType;
+        unsigned int VAO;
+        unsigned int VBO;
+        unsigned int EBO;
+        // in bytes
+        std::size_t vertexCapacity;
+        std::size_t vertexUsed;
+        std::size_t indexCapacity;
+        std::size_t indexUsed;
+    };
+
+    std::size_t vertexBytes;
+    std::size_t indexBytes;
+    std::vector<Pool> pools;
+
+    Pool& poolFor(VertexFormat format, GLenum indexType);
+    // reallocates a pool buffer with at least required bytes, keeping the
+    // contents and pointing the pool's VAO at the new buffer
+    void grow(Pool& pool, GLenum target, std::size_t required);
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // GEOMETRY_ARENA_H
@@ -0,0 +1,69 @@
+#include "gl_state.h"
+
+#include <cstring>
+
+namespace personal::renderer::utility {
+
+bool hasExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* extension = reinterpret_cast<const char*>(
+            glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (extension && std::strcmp(extension, name) == 0) return true;
+    }
+    return false;
+}
+
+GLStateTracker::GLStateTracker() { reset(); }
+
+void GLStateTracker::reset() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    activeUnit = UNKNOWN;
+    for (unsigned int& texture : textures) texture = UNKNOWN;
+}
+
+void GLStateTracker::useProgram(unsigned int id) {
+    if (change(program, id)) glUseProgram(id);
+}
+
+void GLStateTracker::bindVertexArray(unsigned int id) {
+    if (change(vertexArray, id)) glBindVertexArray(id);
+}
+
+void GLStateTracker::bindTexture(unsigned int unit, unsigned int texture) {
+    // units past the shadowed ones are always bound
+    if (unit >= TEXTURE_UNITS) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        activeUnit = unit;
+        counters.issued += 2;
+        return;
+    }
+
+    if (textures[unit] == texture) {
+        ++counters.elided;
+        return;
+    }
+    if (change(activeUnit, unit)) glActiveTexture(GL_TEXTURE0 + unit);
+    textures[unit] = texture;
+    ++counters.issued;
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+const GLStateTracker::Stats& GLStateTracker::stats() const { return counters; }
+
+void GLStateTracker::resetStats() { counters = Stats{}; }
+
+bool GLStateTracker::change(unsigned int& current, unsigned int value) {
+    if (current == value) {
+        ++counters.elided;
+        return false;
+    }
+    current = value;
+    ++counters.issued;
+    return true;
+}
+
+}  // namespace personal::renderer::utility
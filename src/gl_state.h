@@ -0,0 +1,58 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+namespace personal::renderer::utility {
+
+// whether the current context offers the named extension
+bool hasExtension(const char* name);
+
+// Shadows the bits of GL binding state the renderer changes per draw and
+// skips calls that would set what is already bound. Only valid while nothing
+// else touches that state, so call reset() after handing the context to other
+// code (ImGui, texture uploads, ...).
+class GLStateTracker {
+   public:
+    static const unsigned int TEXTURE_UNITS = 16;
+
+    struct Stats {
+        // calls that reached the driver
+        std::size_t issued{0};
+        // calls skipped because the state was already set
+        std::size_t elided{0};
+    };
+
+    GLStateTracker();
+
+    // forgets every binding, so the next call of each kind is issued
+    void reset();
+
+    void useProgram(unsigned int id);
+    void bindVertexArray(unsigned int id);
+    // binds a 2D texture to the given unit, switching the active unit only
+    // when needed
+    void bindTexture(unsigned int unit, unsigned int texture);
+
+    const Stats& stats() const;
+    void resetStats();
+
+   private:
+    // marks a binding whose value isn't known
+    static const unsigned int UNKNOWN = ~0u;
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int activeUnit;
+    unsigned int textures[TEXTURE_UNITS];
+    Stats counters;
+
+    // whether current has to change to value, updating it and the counters
+    bool change(unsigned int& current, unsigned int value);
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // GL_STATE_H
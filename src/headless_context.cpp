@@ -0,0 +1,132 @@
+#include "headless_context.h"
+
+// clang-format off
+#include <glad/glad.h>
+#include <EGL/eglext.h>
+// clang-format on
+
+#include <iostream>
+
+namespace personal::renderer::utility {
+
+namespace {
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+EGLDisplay openDisplay() {
+    // the surfaceless platform needs neither X11 nor a DRM device
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                                EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY) return display;
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+void* loadProc(const char* name) {
+    return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
+
+}  // namespace
+
+HeadlessContext::HeadlessContext(int width, int height)
+    : width(width), height(height) {
+    ready = createContext() && createFramebuffer();
+}
+
+HeadlessContext::~HeadlessContext() {
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colourBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+    }
+    if (display == EGL_NO_DISPLAY) return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+    eglTerminate(display);
+}
+
+bool HeadlessContext::valid() const { return ready; }
+
+bool HeadlessContext::createContext() {
+    display = openDisplay();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        std::cout << "ERROR::HEADLESS_CONTEXT::NO_DISPLAY: 0x" << std::hex
+                  << eglGetError() << std::dec << '\n';
+        display = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    // no surface, so the config only needs to support desktop GL
+    const EGLint configAttributes[] = {EGL_SURFACE_TYPE, 0,
+                                       EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                       EGL_NONE};
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1,
+                         &configCount) ||
+        configCount == 0) {
+        std::cout << "ERROR::HEADLESS_CONTEXT::NO_CONFIG\n";
+        return false;
+    }
+
+    // 4.3 if the driver has it, for the compute culled draws, else 3.3
+    const EGLint VERSIONS[][2] = {{4, 3}, {3, 3}};
+    if (eglBindAPI(EGL_OPENGL_API)) {
+        for (const EGLint* version : VERSIONS) {
+            const EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION,       version[0],
+                EGL_CONTEXT_MINOR_VERSION,       version[1],
+                EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE};
+            context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+                                       contextAttributes);
+            if (context != EGL_NO_CONTEXT) break;
+        }
+    }
+    if (context == EGL_NO_CONTEXT) {
+        std::cout << "ERROR::HEADLESS_CONTEXT::CONTEXT_CREATION_FAILED: 0x"
+                  << std::hex << eglGetError() << std::dec << '\n';
+        return false;
+    }
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cout << "ERROR::HEADLESS_CONTEXT::SURFACELESS_UNSUPPORTED\n";
+        return false;
+    }
+
+    if (!gladLoadGLLoader(loadProc)) {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool HeadlessContext::createFramebuffer() {
+    glGenRenderbuffers(1, &colourBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, colourBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::HEADLESS_CONTEXT::FRAMEBUFFER_INCOMPLETE\n";
+        return false;
+    }
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,45 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <EGL/egl.h>
+
+namespace personal::renderer::utility {
+
+// An OpenGL 4.3 core context, or 3.3 if the driver has no 4.3, without a
+// window, for benchmarks and CI. Uses EGL's surfaceless platform when the
+// driver offers it (Mesa, including llvmpipe on machines without a GPU) and
+// the default display otherwise.
+// Since there is no surface, rendering goes to an offscreen framebuffer of
+// the given size, which is left bound.
+//
+// Also loads the GL function pointers, so use it instead of Window and
+// gladLoadGLLoader.
+class HeadlessContext {
+   public:
+    int width;
+    int height;
+
+    HeadlessContext(int width = 1280, int height = 720);
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // false if any step failed; the reason has been printed
+    bool valid() const;
+
+   private:
+    EGLDisplay display{EGL_NO_DISPLAY};
+    EGLContext context{EGL_NO_CONTEXT};
+    unsigned int framebuffer{0};
+    unsigned int colourBuffer{0};
+    unsigned int depthBuffer{0};
+    bool ready{false};
+
+    bool createContext();
+    bool createFramebuffer();
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // HEADLESS_CONTEXT_H
@@ -0,0 +1,522 @@
+#include "instanced_model.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "job_system.h"
+#include "lod_selector.h"
+#include "render_queue.h"
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// fewest instances worth a job of their own
+const std::size_t MIN_INSTANCE_CHUNK = 4096;
+// local_size_x of shaders/cull_instances.comp
+const std::size_t CULL_GROUP_SIZE = 64;
+
+// an instance's bounds as shaders/cull_instances.comp reads them (std430)
+struct GpuBounds {
+    // w unused
+    glm::vec4 center;
+    // w is the instance's scale
+    glm::vec4 extent;
+    // radius in w
+    glm::vec4 sphere;
+};
+
+// GL's DrawElementsIndirectCommand
+struct DrawCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+bool signaled(GLsync fence) {
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+}
+
+}  // namespace
+
+InstancedModel::InstancedModel(const AssimpModel& model, std::size_t capacity)
+    : model(model), capacity(0) {
+    glGenBuffers(1, &instanceVBO);
+    reserve(std::max<std::size_t>(capacity, 1));
+
+    for (const Mesh& mesh : model.meshes) {
+        if (mesh.lods.size() > levels.size()) levels.resize(mesh.lods.size());
+        for (std::size_t i = 0; i < mesh.lods.size(); ++i)
+            levels[i].error = std::max(levels[i].error, mesh.lods[i].error);
+    }
+    // meshes with fewer levels stay at their last one, whose error is
+    // already covered
+    for (std::size_t i = 1; i < levels.size(); ++i)
+        levels[i].error = std::max(levels[i].error, levels[i - 1].error);
+
+    // the attribute pointers reference the buffer object rather than its
+    // storage, so they stay valid when reserve() reallocates it
+    for (const Mesh& mesh : model.meshes) {
+        if (mesh.arena) {
+            // the VAO is shared with every other mesh in the arena pool
+            std::cout << "ERROR::INSTANCED_MODEL::SHARED_VERTEX_ARRAY: "
+                         "instanced models can't use a geometry arena\n";
+            continue;
+        }
+        glBindVertexArray(mesh.VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        // a mat4 attribute takes up four consecutive vec4 locations
+        for (unsigned int column = 0; column < 4; ++column) {
+            unsigned int location = INSTANCE_MATRIX_LOCATION + column;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE,
+                                  sizeof(glm::mat4),
+                                  (void*)(column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(location, 1);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+InstancedModel::~InstancedModel() {
+    glDeleteBuffers(1, &instanceVBO);
+    for (unsigned int buffer :
+         {transformSSBO, boundsSSBO, levelSSBO, errorSSBO, commandBuffer})
+        if (buffer) glDeleteBuffers(1, &buffer);
+    for (Readback& readback : readbacks) {
+        if (readback.fence) glDeleteSync(readback.fence);
+        if (readback.buffer) glDeleteBuffers(1, &readback.buffer);
+    }
+}
+
+void InstancedModel::setInstances(const std::vector<glm::mat4>& transforms) {
+    this->transforms = transforms;
+    instanceBounds.resize(transforms.size());
+    instanceSpheres.resize(transforms.size());
+    instanceScales.resize(transforms.size());
+    instanceLevels.assign(transforms.size(), 0);
+    updateBounds(0, transforms.size());
+    markDirty(0, transforms.size());
+
+    reserve(transforms.size());
+    upload(transforms.data(), transforms.size());
+    bufferHoldsAll = true;
+}
+
+void InstancedModel::updateInstances(std::size_t first,
+                                     const glm::mat4* transforms,
+                                     std::size_t count) {
+    if (count == 0) return;
+    if (first + count > this->transforms.size()) {
+        this->transforms.resize(first + count);
+        instanceBounds.resize(first + count);
+        instanceSpheres.resize(first + count);
+        instanceScales.resize(first + count);
+        instanceLevels.resize(first + count, 0);
+    }
+    std::copy(transforms, transforms + count, this->transforms.begin() + first);
+    updateBounds(first, count);
+    markDirty(first, count);
+
+    if (this->transforms.size() > capacity) {
+        // reserve() re-uploads the whole mirror, including this range
+        reserve(this->transforms.size());
+        return;
+    }
+    // a culled draw left only the visible subset in the buffer; the next
+    // draw uploads the mirror anyway
+    if (!bufferHoldsAll) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(glm::mat4),
+                    count * sizeof(glm::mat4), transforms);
+}
+
+std::size_t InstancedModel::instanceCount() const { return transforms.size(); }
+
+const std::vector<glm::mat4>& InstancedModel::instances() const {
+    return transforms;
+}
+
+void InstancedModel::draw(const Shader& shader) const {
+    if (!bufferHoldsAll) {
+        upload(transforms.data(), transforms.size());
+        bufferHoldsAll = true;
+    }
+    for (const Mesh& mesh : model.meshes)
+        mesh.drawInstanced(shader, transforms.size());
+}
+
+void InstancedModel::draw(const Shader& shader, const Frustum& frustum,
+                          CullingStats& stats) const {
+    std::size_t visible = uploadVisible(frustum, stats);
+    for (const Mesh& mesh : model.meshes) mesh.drawInstanced(shader, visible);
+}
+
+void InstancedModel::submit(RenderQueue& queue, const Shader& shader,
+                            const Frustum& frustum, CullingStats& stats,
+                            const LodSelector* lod) const {
+    prepare(frustum, stats, lod);
+    submitPrepared(queue, shader);
+}
+
+void InstancedModel::prepare(const Frustum& frustum, CullingStats& stats,
+                             const LodSelector* lod) const {
+    JobSystem& jobs = JobSystem::shared();
+    const std::size_t count = transforms.size();
+    const std::size_t levelTotal = std::max<std::size_t>(levels.size(), 1);
+    const std::size_t chunk = jobs.chunkSize(count, MIN_INSTANCE_CHUNK);
+    chunks.resize((count + chunk - 1) / chunk);
+
+    // cull each chunk and select its visible instances' levels
+    jobs.parallelFor(count, chunk, [&](std::size_t begin, std::size_t end) {
+        PrepareChunk& part = chunks[begin / chunk];
+        part.visible.clear();
+        part.stats.reset();
+        part.levelCount.assign(levelTotal, 0);
+        cullBounds(frustum, instanceBounds, begin, end - begin, part.visible,
+                   part.stats);
+        if (!lod) {
+            part.levelCount[0] = part.visible.size();
+            return;
+        }
+        for (unsigned int i : part.visible) {
+            const BoundingSphere& sphere = instanceSpheres[i];
+            float distance = lod->distanceTo(sphere.center, sphere.radius);
+            instanceLevels[i] = lod->select(levels, instanceScales[i],
+                                            distance, instanceLevels[i]);
+            ++part.levelCount[instanceLevels[i]];
+        }
+    });
+
+    levelFirst.assign(levelTotal, 0);
+    levelCount.assign(levelTotal, 0);
+    std::size_t visible = 0;
+    for (const PrepareChunk& part : chunks) {
+        stats.tested += part.stats.tested;
+        stats.visible += part.stats.visible;
+        visible += part.visible.size();
+        for (std::size_t level = 0; level < levelTotal; ++level)
+            levelCount[level] += part.levelCount[level];
+    }
+    visibleTransforms.resize(visible);
+
+    std::size_t finest = 0;
+    if (!GLAD_GL_VERSION_4_2) {
+        // no base instance, so every instance has to start at 0 and be drawn
+        // at the finest level any of them needs
+        while (finest < levelTotal && levelCount[finest] == 0) ++finest;
+        if (finest < levelTotal) stats.promoted += visible - levelCount[finest];
+        levelCount.assign(levelTotal, 0);
+        if (finest < levelTotal) levelCount[finest] = visible;
+        // the chunks' instances simply follow each other
+        std::size_t offset = 0;
+        for (PrepareChunk& part : chunks) {
+            part.levelOffset.assign(1, offset);
+            offset += part.visible.size();
+        }
+    } else {
+        // counting sort of the visible instances by level, each chunk's share
+        // of a level after the earlier chunks'
+        std::size_t first = 0;
+        for (std::size_t level = 0; level < levelTotal; ++level) {
+            levelFirst[level] = first;
+            first += levelCount[level];
+        }
+        std::vector<std::size_t> offsets = levelFirst;
+        for (PrepareChunk& part : chunks) {
+            part.levelOffset.resize(levelTotal);
+            for (std::size_t level = 0; level < levelTotal; ++level) {
+                part.levelOffset[level] = offsets[level];
+                offsets[level] += part.levelCount[level];
+            }
+        }
+    }
+
+    // each chunk copies its visible transforms into place. Without a base
+    // instance the level drawn is kept, so the hysteresis starts from it.
+    bool byLevel = lod && GLAD_GL_VERSION_4_2;
+    bool drawnFinest = lod && !GLAD_GL_VERSION_4_2;
+    jobs.parallelFor(chunks.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t c = begin; c < end; ++c) {
+            std::vector<std::size_t>& offsets = chunks[c].levelOffset;
+            for (unsigned int i : chunks[c].visible) {
+                std::size_t level = byLevel ? instanceLevels[i] : 0;
+                if (drawnFinest)
+                    instanceLevels[i] = static_cast<std::uint8_t>(finest);
+                visibleTransforms[offsets[level]++] = transforms[i];
+            }
+        }
+    });
+}
+
+void InstancedModel::submitPrepared(RenderQueue& queue,
+                                    const Shader& shader) const {
+    if (uploadPrepared() == 0) return;
+    for (std::size_t level = 0; level < levelCount.size(); ++level) {
+        if (levelCount[level] == 0) continue;
+        for (const Mesh& mesh : model.meshes)
+            queue.submit(mesh, shader, glm::mat4(1.0f), RenderPass::Opaque,
+                         levelCount[level], static_cast<std::uint8_t>(level),
+                         levelFirst[level]);
+    }
+}
+
+bool InstancedModel::indirectSupported() { return GLAD_GL_VERSION_4_3; }
+
+void InstancedModel::drawIndirect(const Shader& shader,
+                                  const Shader& cullShader,
+                                  const Frustum& frustum, CullingStats& stats,
+                                  const LodSelector* lod) const {
+    const std::size_t count = transforms.size();
+    const std::size_t levelTotal = std::max<std::size_t>(levels.size(), 1);
+    readBackVisible();
+    stats.tested += count;
+    stats.visible += gpuVisible;
+    if (count == 0) return;
+
+    uploadGpuInstances();
+
+    // every command starts out with no instances. Level l's visible instances
+    // go to the l-th slice of the instance buffer, for all meshes alike.
+    std::vector<DrawCommand> commands;
+    commands.reserve(model.meshes.size() * levelTotal);
+    for (const Mesh& mesh : model.meshes) {
+        for (std::size_t level = 0; level < levelTotal; ++level) {
+            const MeshLod& range = mesh.lod(level);
+            commands.push_back(
+                {static_cast<GLuint>(range.indexCount), 0,
+                 static_cast<GLuint>(mesh.firstIndex + range.firstIndex),
+                 mesh.baseVertex, static_cast<GLuint>(level * count)});
+        }
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand),
+                 commands.data(), GL_DYNAMIC_DRAW);
+
+    cullShader.resolve();
+    glUseProgram(cullShader.ID);
+    glUniform1ui(cullShader.uniformLocation("instanceCount"),
+                 static_cast<GLuint>(count));
+    glUniform1ui(cullShader.uniformLocation("levelCount"),
+                 static_cast<GLuint>(levelTotal));
+    glUniform1ui(cullShader.uniformLocation("meshCount"),
+                 static_cast<GLuint>(model.meshes.size()));
+    glUniform4fv(cullShader.uniformLocation("planes"), 6,
+                 &frustum.planes[0][0]);
+    if (lod) {
+        cullShader.setVec3("cameraPosition", lod->camera());
+        cullShader.setFloat("pixelsPerUnit", lod->pixelScale());
+        cullShader.setFloat("pixelError", lod->errorThreshold());
+    } else {
+        cullShader.setFloat("pixelError", 0.0f);
+    }
+    unsigned int bindings[] = {transformSSBO, boundsSSBO, levelSSBO,
+                               errorSSBO,     instanceVBO, commandBuffer};
+    for (unsigned int i = 0; i < 6; ++i)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, bindings[i]);
+    glDispatchCompute(
+        static_cast<GLuint>((count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1,
+        1);
+    // the draws read the commands and the instances, the readback copies
+    // the commands
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT |
+                    GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+                    GL_BUFFER_UPDATE_BARRIER_BIT);
+    bufferHoldsAll = false;
+
+    glUseProgram(shader.ID);
+    for (std::size_t i = 0; i < model.meshes.size(); ++i)
+        model.meshes[i].drawIndirect(shader,
+                                     i * levelTotal * sizeof(DrawCommand),
+                                     levelTotal);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    // every command, for the visible count and what was drawn. A slot whose
+    // last copy the GPU hasn't finished yet skips this frame.
+    Readback& readback = readbacks[nextReadback];
+    if (readback.fence) return;
+    const std::size_t commandBytes = commands.size() * sizeof(DrawCommand);
+    if (!readback.buffer) {
+        glGenBuffers(1, &readback.buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, commandBytes, nullptr,
+                     GL_STREAM_READ);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readback.buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        commandBytes);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    nextReadback = (nextReadback + 1) % READBACKS;
+}
+
+std::size_t InstancedModel::uploadVisible(const Frustum& frustum,
+                                          CullingStats& stats,
+                                          const LodSelector* lod) const {
+    prepare(frustum, stats, lod);
+    return uploadPrepared();
+}
+
+std::size_t InstancedModel::uploadPrepared() const {
+    upload(visibleTransforms.data(), visibleTransforms.size());
+    bufferHoldsAll = false;
+    return visibleTransforms.size();
+}
+
+void InstancedModel::setInstanceBounds(std::size_t i) {
+    const glm::mat4& transform = transforms[i];
+    instanceBounds.set(i, transformBounds(model.bounds, transform));
+    instanceScales[i] = maxScale(transform);
+    instanceSpheres[i].center =
+        glm::vec3(transform * glm::vec4(model.bounds.center(), 1.0f));
+    instanceSpheres[i].radius =
+        glm::length(model.bounds.extent()) * instanceScales[i];
+}
+
+const InstancedModel::IndirectStats& InstancedModel::indirectStats() const {
+    return drawStats;
+}
+
+void InstancedModel::markDirty(std::size_t first, std::size_t count) {
+    if (dirtyFirst == dirtyEnd) {
+        dirtyFirst = first;
+        dirtyEnd = first + count;
+        return;
+    }
+    dirtyFirst = std::min(dirtyFirst, first);
+    dirtyEnd = std::max(dirtyEnd, first + count);
+}
+
+void InstancedModel::uploadGpuInstances() const {
+    const std::size_t count = transforms.size();
+    const std::size_t levelTotal = std::max<std::size_t>(levels.size(), 1);
+    if (!commandBuffer) {
+        glGenBuffers(1, &transformSSBO);
+        glGenBuffers(1, &boundsSSBO);
+        glGenBuffers(1, &levelSSBO);
+        glGenBuffers(1, &errorSSBO);
+        glGenBuffers(1, &commandBuffer);
+
+        std::vector<float> errors(levelTotal, 0.0f);
+        for (std::size_t level = 0; level < levels.size(); ++level)
+            errors[level] = levels[level].error;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, errorSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, errors.size() * sizeof(float),
+                     errors.data(), GL_STATIC_DRAW);
+    }
+    // the compute shader writes each level's visible instances to a slice
+    // of the instance buffer as large as all of them
+    reserve(count * levelTotal);
+
+    if (count > gpuCapacity) {
+        // levels start over at the finest one
+        gpuCapacity = count;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, transformSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(glm::mat4),
+                     nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GpuBounds),
+                     nullptr, GL_DYNAMIC_DRAW);
+        std::vector<GLuint> startLevels(count, 0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, levelSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GLuint),
+                     startLevels.data(), GL_DYNAMIC_DRAW);
+        dirtyFirst = 0;
+        dirtyEnd = count;
+    }
+    if (dirtyFirst == dirtyEnd) return;
+
+    dirtyEnd = std::min(dirtyEnd, count);
+    std::size_t changed = dirtyEnd - dirtyFirst;
+    std::vector<GpuBounds> bounds(changed);
+    for (std::size_t i = 0; i < changed; ++i) {
+        std::size_t instance = dirtyFirst + i;
+        const BoundingSphere& sphere = instanceSpheres[instance];
+        bounds[i] = {glm::vec4(instanceBounds.centerX[instance],
+                               instanceBounds.centerY[instance],
+                               instanceBounds.centerZ[instance], 0.0f),
+                     glm::vec4(instanceBounds.extentX[instance],
+                               instanceBounds.extentY[instance],
+                               instanceBounds.extentZ[instance],
+                               instanceScales[instance]),
+                     glm::vec4(sphere.center, sphere.radius)};
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, transformSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirtyFirst * sizeof(glm::mat4),
+                    changed * sizeof(glm::mat4), &transforms[dirtyFirst]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, dirtyFirst * sizeof(GpuBounds),
+                    changed * sizeof(GpuBounds), bounds.data());
+    dirtyFirst = dirtyEnd = 0;
+}
+
+void InstancedModel::readBackVisible() const {
+    const std::size_t levelTotal = std::max<std::size_t>(levels.size(), 1);
+    // oldest first, so the newest finished counts are the ones kept
+    for (std::size_t i = 0; i < READBACKS; ++i) {
+        Readback& readback = readbacks[(nextReadback + i) % READBACKS];
+        if (!readback.fence || !signaled(readback.fence)) continue;
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+
+        std::vector<DrawCommand> commands(model.meshes.size() * levelTotal);
+        glBindBuffer(GL_COPY_READ_BUFFER, readback.buffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0,
+                           commands.size() * sizeof(DrawCommand),
+                           commands.data());
+        // the first mesh's commands count every visible instance once
+        gpuVisible = 0;
+        for (std::size_t level = 0; level < levelTotal; ++level)
+            gpuVisible += commands[level].instanceCount;
+        // a command with instances is what the CPU path queues as a draw
+        drawStats = IndirectStats{};
+        for (const DrawCommand& command : commands) {
+            if (command.instanceCount == 0) continue;
+            ++drawStats.drawCalls;
+            drawStats.triangles += static_cast<std::size_t>(command.count) /
+                                   3 * command.instanceCount;
+        }
+    }
+}
+
+void InstancedModel::updateBounds(std::size_t first, std::size_t count) {
+    JobSystem& jobs = JobSystem::shared();
+    jobs.parallelFor(count, jobs.chunkSize(count, MIN_INSTANCE_CHUNK),
+                     [&](std::size_t begin, std::size_t end) {
+                         for (std::size_t i = begin; i < end; ++i)
+                             setInstanceBounds(first + i);
+                     });
+}
+
+void InstancedModel::reserve(std::size_t count) const {
+    if (count <= capacity) return;
+
+    // grow geometrically so repeated appends don't reallocate every time
+    capacity = std::max(count, capacity + capacity / 2);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), nullptr,
+                 GL_DYNAMIC_DRAW);
+    if (!transforms.empty())
+        glBufferSubData(GL_ARRAY_BUFFER, 0,
+                        transforms.size() * sizeof(glm::mat4),
+                        transforms.data());
+    bufferHoldsAll = true;
+}
+
+void InstancedModel::upload(const glm::mat4* matrices,
+                            std::size_t count) const {
+    // orphan the old storage so the driver doesn't have to wait for draws
+    // still reading it
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::mat4), nullptr,
+                 GL_DYNAMIC_DRAW);
+    if (count > 0)
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4),
+                        matrices);
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,172 @@
+#ifndef INSTANCED_MODEL_H
+#define INSTANCED_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "model.h"
+
+namespace personal::renderer::utility {
+
+// First of the four attribute locations holding the per-instance model
+// matrix. Comes after the standard vertex attributes (0-6).
+const unsigned int INSTANCE_MATRIX_LOCATION = 7;
+
+// Draws many copies of an AssimpModel with one instanced draw call per mesh.
+// Owns a buffer of per-instance model matrices that is attached to each of the
+// model's mesh VAOs at INSTANCE_MATRIX_LOCATION with a divisor of 1, so the
+// shader reads it as 'layout(location = 7) in mat4 aInstanceMatrix'.
+class InstancedModel : public Model {
+   public:
+    InstancedModel(const AssimpModel& model, std::size_t capacity = 0);
+    ~InstancedModel();
+
+    InstancedModel(const InstancedModel&) = delete;
+    InstancedModel& operator=(const InstancedModel&) = delete;
+
+    // replaces every instance
+    void setInstances(const std::vector<glm::mat4>& transforms);
+    // overwrites count instances starting at first, only uploading that
+    // range. Grows the instance count if the range runs past the end.
+    void updateInstances(std::size_t first, const glm::mat4* transforms,
+                         std::size_t count);
+
+    std::size_t instanceCount() const;
+    const std::vector<glm::mat4>& instances() const;
+
+    void draw(const Shader& shader) const override;
+    // only draws the instances whose world space bounds intersect the
+    // frustum (built from projection * view). The visible instances' matrices
+    // are compacted into the instance buffer, so this is still one draw call
+    // per mesh.
+    void draw(const Shader& shader, const Frustum& frustum,
+              CullingStats& stats) const;
+    // culls and uploads like the culled draw, then queues each mesh as one
+    // instanced draw of the visible instances. With a LodSelector the visible
+    // instances are grouped by the level of detail it selects for each, and
+    // each mesh is queued once per level drawn, with the group as its range
+    // of instances. Selecting a range needs GL 4.2; before that every visible
+    // instance is drawn at the finest level any of them needs, counted in
+    // stats.promoted.
+    void submit(RenderQueue& queue, const Shader& shader,
+                const Frustum& frustum, CullingStats& stats,
+                const LodSelector* lod = nullptr) const;
+    // the two halves of submit(): prepare() culls the instances and groups
+    // the visible ones by level, in chunks spread over the shared JobSystem.
+    // It doesn't touch GL, so it can run as a job itself. submitPrepared()
+    // then uploads and queues what it found, on the GL thread.
+    void prepare(const Frustum& frustum, CullingStats& stats,
+                 const LodSelector* lod = nullptr) const;
+    void submitPrepared(RenderQueue& queue, const Shader& shader) const;
+
+    // whether drawIndirect() can be used, which needs GL 4.3
+    static bool indirectSupported();
+    // draws the visible instances without looking at any of them on the CPU.
+    // cullShader (shaders/cull_instances.comp) culls every instance and
+    // selects its level on the GPU, writing the visible transforms into the
+    // instance buffer and counting them into one indirect draw command per
+    // mesh and level. Each mesh is then drawn by one
+    // glMultiDrawElementsIndirect over its levels. Per frame only the
+    // commands, a few uniforms and changed instances are uploaded, so the CPU
+    // cost doesn't grow with the instance count. The visible count added to
+    // stats is read back without waiting for the GPU, so it lags a few frames
+    // behind. shader has to be in use, and is again afterwards.
+    void drawIndirect(const Shader& shader, const Shader& cullShader,
+                      const Frustum& frustum, CullingStats& stats,
+                      const LodSelector* lod = nullptr) const;
+    // what drawIndirect() drew, read back along with the visible count and
+    // lagging as much. Every command with instances counts as a draw call,
+    // as the queue would count it, though each mesh takes just one call.
+    struct IndirectStats {
+        std::size_t drawCalls{0};
+        std::size_t triangles{0};
+    };
+    const IndirectStats& indirectStats() const;
+
+   private:
+    // the part of prepare() one job does: the visible instances of a range,
+    // how many of them are drawn at each level and where in the compacted
+    // transforms each level's share of them goes
+    struct PrepareChunk {
+        std::vector<unsigned int> visible;
+        std::vector<std::size_t> levelCount;
+        std::vector<std::size_t> levelOffset;
+        CullingStats stats;
+    };
+    // a buffer drawIndirect() copies the first mesh's commands into, and the
+    // fence after the copy
+    struct Readback {
+        unsigned int buffer{0};
+        GLsync fence{nullptr};
+    };
+    static const std::size_t READBACKS = 3;
+
+    const AssimpModel& model;
+    unsigned int instanceVBO;
+    // matrices the instance buffer has room for; drawIndirect() grows it to
+    // one slice of every instance per level
+    mutable std::size_t capacity;
+    // every instance's transform, re-uploaded whenever the buffer has to
+    // grow or last held a culled subset
+    std::vector<glm::mat4> transforms;
+    // the model's bounds transformed by each instance
+    BoundsSoA instanceBounds;
+    // each level's largest error over all meshes, for picking one level for
+    // the whole model
+    std::vector<MeshLod> levels;
+    // the model's bounding sphere in world space, and the scale applied to
+    // it, per instance
+    std::vector<BoundingSphere> instanceSpheres;
+    std::vector<float> instanceScales;
+    // the level each instance was last drawn at
+    mutable std::vector<std::uint8_t> instanceLevels;
+    // the range of the uploaded visible instances drawn at each level
+    mutable std::vector<std::size_t> levelFirst;
+    mutable std::vector<std::size_t> levelCount;
+    // false while the buffer holds the visible subset from a culled draw
+    mutable bool bufferHoldsAll{true};
+    mutable std::vector<PrepareChunk> chunks;
+    mutable std::vector<glm::mat4> visibleTransforms;
+    // drawIndirect()'s copies of every instance's transform, bounds and
+    // level, how many instances they have room for and the range of
+    // instances changed since they were last uploaded
+    mutable unsigned int transformSSBO{0};
+    mutable unsigned int boundsSSBO{0};
+    mutable unsigned int levelSSBO{0};
+    mutable unsigned int errorSSBO{0};
+    mutable unsigned int commandBuffer{0};
+    mutable std::size_t gpuCapacity{0};
+    mutable std::size_t dirtyFirst{0};
+    mutable std::size_t dirtyEnd{0};
+    mutable Readback readbacks[READBACKS];
+    mutable std::size_t nextReadback{0};
+    // the visible count and the draws last read back
+    mutable std::size_t gpuVisible{0};
+    mutable IndirectStats drawStats;
+
+    void reserve(std::size_t count) const;
+    // updates everything derived from the i-th instance's transform
+    void setInstanceBounds(std::size_t i);
+    // uploads count matrices to the start of the buffer
+    void upload(const glm::mat4* matrices, std::size_t count) const;
+    // setInstanceBounds() for count instances from first on, in parallel
+    void updateBounds(std::size_t first, std::size_t count);
+    // compacts the visible instances into the buffer, returning their count.
+    // With a LodSelector they are sorted by level into levelFirst/levelCount.
+    std::size_t uploadVisible(const Frustum& frustum, CullingStats& stats,
+                              const LodSelector* lod = nullptr) const;
+    // uploads what prepare() compacted, returning its count
+    std::size_t uploadPrepared() const;
+    // marks count instances from first on for drawIndirect() to upload
+    void markDirty(std::size_t first, std::size_t count);
+    // creates drawIndirect()'s buffers, or brings them up to date
+    void uploadGpuInstances() const;
+    // the counts of the newest readback that has finished
+    void readBackVisible() const;
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // INSTANCED_MODEL_H
@@ -0,0 +1,148 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// the system the current thread is a worker of, and its queue there
+thread_local const JobSystem* workerOf = nullptr;
+thread_local std::size_t workerQueue = 0;
+
+// empty passes over the queues before an idle worker goes to sleep
+const int IDLE_SPINS = 64;
+// chunks per thread parallelFor callers should aim for, see chunkSize()
+const std::size_t CHUNKS_PER_THREAD = 4;
+
+}  // namespace
+
+bool JobSystem::Counter::done() const { return pending.load() == 0; }
+
+JobSystem::JobSystem(unsigned int threadCount) {
+    for (unsigned int i = 0; i <= threadCount; ++i)
+        queues.push_back(std::make_unique<Queue>());
+    for (unsigned int i = 0; i < threadCount; ++i)
+        workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+JobSystem& JobSystem::shared() {
+    static JobSystem system(std::max(1u, std::thread::hardware_concurrency()) -
+                            1);
+    return system;
+}
+
+std::size_t JobSystem::concurrency() const { return workers.size() + 1; }
+
+std::size_t JobSystem::chunkSize(std::size_t count,
+                                 std::size_t minimum) const {
+    std::size_t chunks = concurrency() * CHUNKS_PER_THREAD;
+    return std::max<std::size_t>({(count + chunks - 1) / chunks, minimum, 1});
+}
+
+void JobSystem::run(std::function<void()> job, Counter& counter) {
+    ++counter.pending;
+    Queue& queue = *queues[homeQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(Job{std::move(job), &counter});
+    }
+    ++queued;
+    // a worker that saw no job before the increment is counted as sleeping
+    // by now, see workerLoop()
+    if (sleeping > 0) {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+void JobSystem::wait(Counter& counter) {
+    std::size_t home = homeQueue();
+    while (!counter.done())
+        if (!runOne(home)) std::this_thread::yield();
+}
+
+void JobSystem::parallelFor(
+    std::size_t count, std::size_t chunk,
+    const std::function<void(std::size_t, std::size_t)>& body) {
+    chunk = std::max<std::size_t>(chunk, 1);
+    if (count <= chunk) {
+        if (count > 0) body(0, count);
+        return;
+    }
+
+    Counter counter;
+    for (std::size_t begin = chunk; begin < count; begin += chunk)
+        run([&body, begin, end = std::min(count, begin + chunk)]() {
+                body(begin, end);
+            },
+            counter);
+    body(0, chunk);
+    wait(counter);
+}
+
+void JobSystem::workerLoop(std::size_t queue) {
+    workerOf = this;
+    workerQueue = queue;
+    int idle = 0;
+    while (!stopping) {
+        if (runOne(queue)) {
+            idle = 0;
+            continue;
+        }
+        if (++idle < IDLE_SPINS) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        ++sleeping;
+        wake.wait(lock, [this]() { return stopping || queued > 0; });
+        --sleeping;
+        idle = 0;
+    }
+}
+
+std::size_t JobSystem::homeQueue() const {
+    return workerOf == this ? workerQueue : 0;
+}
+
+bool JobSystem::runOne(std::size_t home) {
+    Job job;
+    bool found = false;
+    {
+        // newest first from our own queue, for locality
+        Queue& queue = *queues[home];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty()) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            found = true;
+        }
+    }
+    // oldest first from everyone else's
+    for (std::size_t i = 1; !found && i < queues.size(); ++i) {
+        Queue& queue = *queues[(home + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) continue;
+        job = std::move(queue.jobs.front());
+        queue.jobs.pop_front();
+        found = true;
+    }
+    if (!found) return false;
+
+    --queued;
+    job.function();
+    --job.counter->pending;
+    return true;
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,96 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace personal::renderer::utility {
+
+// Work-stealing scheduler for the short jobs that prepare a frame: culling,
+// level of detail selection and recording draws. Each worker owns a deque,
+// pushing and popping its own jobs at the back; once it runs dry it steals
+// from the front of the others', so the oldest jobs are the ones that move
+// between threads. Threads outside the system share one more deque.
+//
+// Completion is tracked with counters. Every job counts itself on the
+// counter it is run with until it finishes, and wait() keeps running jobs
+// until the counter drops to zero, so jobs can wait for jobs they spawned
+// without tying up a worker.
+//
+// Kept apart from ThreadPool, whose loading tasks can take hundreds of
+// milliseconds and would hold up a frame queued behind them.
+class JobSystem {
+   public:
+    // unfinished jobs run with it; has to outlive them
+    class Counter {
+       public:
+        bool done() const;
+
+       private:
+        friend class JobSystem;
+        std::atomic<std::size_t> pending{0};
+    };
+
+    explicit JobSystem(unsigned int threadCount);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // process-wide system with one worker per hardware thread (minus the
+    // calling thread, which works through jobs while it waits)
+    static JobSystem& shared();
+
+    // the workers and the calling thread
+    std::size_t concurrency() const;
+    // a chunk size for splitting count items so every thread gets a few
+    // chunks to balance with, but no chunk smaller than minimum
+    std::size_t chunkSize(std::size_t count, std::size_t minimum) const;
+
+    void run(std::function<void()> job, Counter& counter);
+    // runs jobs until every job run with counter has finished
+    void wait(Counter& counter);
+    // calls body(begin, end) for consecutive ranges of chunk items covering
+    // [0, count), the first one on the calling thread, and returns once
+    // every call has finished. So range begin / chunk is the chunk's index.
+    void parallelFor(
+        std::size_t count, std::size_t chunk,
+        const std::function<void(std::size_t, std::size_t)>& body);
+
+   private:
+    struct Job {
+        std::function<void()> function;
+        Counter* counter;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::thread> workers;
+    // the shared one for outside threads first, then one per worker
+    std::vector<std::unique_ptr<Queue>> queues;
+    // jobs in all queues, and workers asleep waiting for one
+    std::atomic<std::size_t> queued{0};
+    std::atomic<std::size_t> sleeping{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    void workerLoop(std::size_t queue);
+    // the queue the calling thread pushes to and pops from
+    std::size_t homeQueue() const;
+    // runs a job from home, or one stolen from another queue
+    bool runOne(std::size_t home);
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // JOB_SYSTEM_H
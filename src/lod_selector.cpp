@@ -0,0 +1,61 @@
+#include "lod_selector.h"
+
+#include <algorithm>
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// keeps the camera from dividing by 0 inside an object's bounds
+const float MIN_DISTANCE = 1e-3f;
+
+}  // namespace
+
+LodSelector::LodSelector(const glm::mat4& view, const glm::mat4& projection,
+                         float viewportHeight, float pixelError)
+    : cameraPosition(glm::inverse(view)[3]),
+      // projection[1][1] is cot(fovy / 2) for a perspective projection
+      pixelsPerUnit(projection[1][1] * viewportHeight * 0.5f),
+      pixelError(pixelError) {}
+
+float LodSelector::distanceTo(const glm::vec3& center, float radius) const {
+    return std::max(glm::length(center - cameraPosition) - radius,
+                    MIN_DISTANCE);
+}
+
+std::uint8_t LodSelector::select(const std::vector<MeshLod>& lods,
+                                 float scale, float distance,
+                                 std::uint8_t current) const {
+    if (pixelError <= 0.0f || lods.size() < 2) return 0;
+
+    float pixels = scale * pixelsPerUnit / distance;
+    auto projected = [&](std::size_t level) {
+        return lods[level].error * pixels;
+    };
+
+    // errors only grow with the level
+    std::size_t last = lods.size() - 1;
+    std::size_t level = std::min<std::size_t>(current, last);
+    std::size_t coarser = level;
+    while (coarser < last &&
+           projected(coarser + 1) <= pixelError * (1.0f - LOD_HYSTERESIS))
+        ++coarser;
+    if (coarser > level) return static_cast<std::uint8_t>(coarser);
+
+    while (level > 0 && projected(level) > pixelError) --level;
+    return static_cast<std::uint8_t>(level);
+}
+
+const glm::vec3& LodSelector::camera() const { return cameraPosition; }
+
+float LodSelector::pixelScale() const { return pixelsPerUnit; }
+
+float LodSelector::errorThreshold() const { return pixelError; }
+
+float maxScale(const glm::mat4& transform) {
+    return std::max({glm::length(glm::vec3(transform[0])),
+                     glm::length(glm::vec3(transform[1])),
+                     glm::length(glm::vec3(transform[2]))});
+}
+
+}  // namespace personal::renderer::utility
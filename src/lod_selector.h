@@ -0,0 +1,54 @@
+#ifndef LOD_SELECTOR_H
+#define LOD_SELECTOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "mesh.h"
+
+namespace personal::renderer::utility {
+
+// fraction of the pixel error a coarser level has to stay under before it
+// replaces the current one
+const float LOD_HYSTERESIS = 0.25f;
+
+// Picks levels of detail for one view by projecting their object space error
+// onto the screen. The coarsest level whose error covers at most pixelError
+// pixels is drawn. So that objects near a threshold don't switch back and
+// forth every frame, a coarser level only takes over once its error is
+// LOD_HYSTERESIS below the threshold, while a finer one takes over as soon as
+// the current level goes over it.
+class LodSelector {
+   public:
+    // a pixelError of 0 keeps everything at full detail
+    LodSelector(const glm::mat4& view, const glm::mat4& projection,
+                float viewportHeight, float pixelError);
+
+    // distance from the camera to a world space sphere, never quite 0
+    float distanceTo(const glm::vec3& center, float radius) const;
+    // the level to draw an object at, scaled by scale from object to world
+    // space, distance away from the camera and currently drawn at current
+    std::uint8_t select(const std::vector<MeshLod>& lods, float scale,
+                        float distance, std::uint8_t current) const;
+
+    // what the selection works from, for making the same selection on the GPU
+    const glm::vec3& camera() const;
+    // pixels covered by one world space unit one unit away from the camera
+    float pixelScale() const;
+    float errorThreshold() const;
+
+   private:
+    glm::vec3 cameraPosition;
+    // pixels covered by one world space unit one unit away from the camera
+    float pixelsPerUnit;
+    float pixelError;
+};
+
+// the largest scale a transform applies along any of its axes
+float maxScale(const glm::mat4& transform);
+
+}  // namespace personal::renderer::utility
+
+#endif  // LOD_SELECTOR_H
@@ -10,12 +10,17 @@
 #include "glm/gtc/type_ptr.hpp"
 
 #include <iostream>
+#include <memory>
 
 #include "shader.h"
 #include "camera.h"
-#include "model.h"
+#include "frame_pacer.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "scene.h"
 #include "window.h"
 #include "texture.h"
+#include "texture_cache.h"
 
 // clang-format on
 
@@ -50,31 +55,27 @@ int main() {
 
     stbi_set_flip_vertically_on_load(true);
 
-    utility::Shader asteroidShader("shaders/asteroid.vert",
-                                   "shaders/asteroid.frag");
-    utility::Shader planetShader("shaders/planet.vert", "shaders/planet.frag");
-    utility::Shader baseShader("shaders/default.vert", "shaders/default.frag");
-    utility::Shader singleColour("shaders/default.vert",
-                                 "shaders/single_colour.frag");
-
-    utility::AssimpModel rock("res/models/rock/rock.obj");
-    utility::AssimpModel planet("res/models/planet/planet.obj");
-    utility::AssimpModel cube("res/models/cube/cube.obj");
-
-    [[maybe_unused]] unsigned int containerTexture{
+    [[maybe_unused]] utility::TextureHandle containerTexture{
         utility::loadTexture("res/textures/container.jpg")};
 
-    singleColour.use();
-    singleColour.setVec3("colour", glm::vec3(0.0f, 1.0f, 0.0f));
+    std::unique_ptr<utility::Scene> scene = utility::Scene::load("asteroids");
+    window.state.camera.Position = scene->startPosition;
+
+    // CPU and GPU timings of the parts of each frame, see the "Profiler"
+    // window
+    std::unique_ptr<utility::Profiler> profiler =
+        std::make_unique<utility::Profiler>();
+    // swap interval, frame limit and CPU run-ahead, see the "Frame pacing"
+    // window
+    std::unique_ptr<utility::FramePacer> pacer =
+        std::make_unique<utility::FramePacer>();
 
     // render loop
     // -----------
     while (!window.shouldClose()) {
-        // Calc delta time
-        // ---------------
-        float currentFrame = static_cast<float>(glfwGetTime());
-        window.state.deltaTime = currentFrame - window.state.lastFrame;
-        window.state.lastFrame = currentFrame;
+        // waits for the GPU and the frame limiter before any input is read
+        pacer->beginFrame();
+        profiler->beginFrame();
 
         // imgui frame init
         // ----------------
@@ -82,42 +83,119 @@ int main() {
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
+        {
+            utility::ProfileScope scope(*profiler, "Clear");
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
+
+        // late latching: poll IO events (keys pressed/released, mouse moved
+        // etc.) as late as possible, right before the camera matrices are
+        // written for the frame
+        if (pacer->lateLatch) pacer->latchInput();
+
+        // Calc delta time
+        // ---------------
+        float currentFrame = static_cast<float>(glfwGetTime());
+        window.state.deltaTime = currentFrame - window.state.lastFrame;
+        window.state.lastFrame = currentFrame;
+
         // Process user input
         // ------------------
         window.processInput();
 
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
         // configure transformation matrices
-        glm::mat4 model = glm::mat4(1.0f);
         glm::mat4 view = window.state.camera.GetViewMatrix();
         glm::mat4 projection =
             glm::perspective(glm::radians(window.state.camera.Zoom),
                              static_cast<float>(window.state.screenWidth) /
                                  static_cast<float>(window.state.screenHeight),
-                             0.1f, 1000.0f);
-
-        singleColour.use();
-        singleColour.setMat4("model", model);
-        singleColour.setMat4("view", view);
-        singleColour.setMat4("projection", projection);
-        cube.draw(singleColour);
+                             0.1f, utility::SCENE_FAR_PLANE);
+        scene->render(view, projection,
+                      static_cast<float>(window.state.screenHeight),
+                      *profiler);
+
+        // renderer statistics
+        // -------------------
+        ImGui::Begin("Stats");
+        ImGui::Text("Uniform lookups avoided: %llu",
+                    static_cast<unsigned long long>(
+                        utility::Shader::locationLookupsAvoided()));
+        const utility::CullingStats& cullingStats = scene->cullingStats();
+        ImGui::Text("Culling: %zu / %zu visible, %zu promoted",
+                    cullingStats.visible, cullingStats.tested,
+                    cullingStats.promoted);
+        const utility::RenderQueue::Stats& queueStats = scene->queueStats();
+        const utility::RenderQueue::Stats& drawStats = scene->drawStats();
+        ImGui::Text("Draws: %zu queued, %zu calls, %zu triangles",
+                    queueStats.items, drawStats.drawCalls,
+                    drawStats.triangles);
+        ImGui::Text("State changes: %zu issued, %zu elided",
+                    queueStats.state.issued, queueStats.state.elided);
+        ImGui::Text("Geometry arena: %zu pools, %.1f MB",
+                    scene->geometry().poolCount(),
+                    static_cast<double>(scene->geometry().usedBytes()) /
+                        (1024.0 * 1024.0));
+        utility::TextureCache::Stats textureStats =
+            utility::TextureCache::shared().stats();
+        ImGui::Text("Textures: %zu, %.1f MB, %zu cache hits / %zu misses",
+                    textureStats.textures,
+                    static_cast<double>(textureStats.bytes) /
+                        (1024.0 * 1024.0),
+                    textureStats.hits, textureStats.misses);
+        const utility::AssetStreamer::Stats& streamingStats =
+            scene->streamingStats();
+        ImGui::Text("Streaming: %zu / %zu models resident, %.1f KB uploaded",
+                    streamingStats.resident, streamingStats.requested,
+                    static_cast<double>(streamingStats.uploadedBytes) / 1024.0);
+        ImGui::Text("Texture staging: %zu uploads, %.1f MB staged, %zu stalls",
+                    streamingStats.textures.uploads,
+                    static_cast<double>(streamingStats.textures.stagedBytes) /
+                        (1024.0 * 1024.0),
+                    streamingStats.textures.stalls);
+        const utility::UniformBuffers::Stats& uniformStats =
+            scene->uniformStats();
+        ImGui::Text("Uniform blocks: %zu draws, %.1f KB, %zu stalls",
+                    uniformStats.draws,
+                    static_cast<double>(uniformStats.bytes) / 1024.0,
+                    uniformStats.stalls);
+        const utility::ProgramCache::Stats& programStats =
+            utility::ProgramCache::shared().stats();
+        ImGui::Text("Program cache: %zu hits / %zu misses, %.1f ms saved",
+                    programStats.hits, programStats.misses,
+                    programStats.savedMilliseconds);
+        ImGui::SliderFloat("LOD pixel error", &scene->lodPixelError, 0.0f,
+                           8.0f);
+        if (utility::InstancedModel::indirectSupported())
+            ImGui::Checkbox("GPU culling", &scene->gpuCulling);
+        ImGui::End();
+        profiler->drawImGui();
+        pacer->drawImGui();
 
         // ImGui end frame
         // ---------------
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse
-        // moved etc.)
+        {
+            utility::ProfileScope scope(*profiler, "ImGui");
+            ImGui::Render();
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
+        profiler->endFrame();
+
+        // glfw: swap buffers, and poll IO events unless that happens late
+        // in the next frame
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window.get());
-        glfwPollEvents();
+        pacer->endFrame();
+        if (!pacer->lateLatch) pacer->latchInput();
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
+    // GL objects have to go while the context still exists
+    scene.reset();
+    containerTexture.reset();
+    profiler.reset();
+    pacer.reset();
 
     // shutdown imgui
     // --------------
@@ -0,0 +1,78 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace personal::renderer::utility {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    fileHandle = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+
+    mappingHandle =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) return;
+
+    void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!view) return;
+
+    mapping = static_cast<const unsigned char*>(view);
+    length = static_cast<std::size_t>(fileSize.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+    if (mapping) UnmapViewOfFile(mapping);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* view = mmap(nullptr, static_cast<std::size_t>(info.st_size),
+                          PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            mapping = static_cast<const unsigned char*>(view);
+            length = static_cast<std::size_t>(info.st_size);
+            // the whole file is about to be streamed into GL buffers
+            madvise(view, length, MADV_WILLNEED);
+        }
+    }
+    // the mapping keeps its own reference to the file
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (mapping) munmap(const_cast<unsigned char*>(mapping), length);
+}
+
+#endif
+
+bool MappedFile::isOpen() const { return mapping != nullptr; }
+
+const unsigned char* MappedFile::data() const { return mapping; }
+
+std::size_t MappedFile::size() const { return length; }
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,34 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace personal::renderer::utility {
+
+// Read-only memory mapping of an entire file. The mapping lives as long as the
+// object does, so pointers returned by data() must not outlive it.
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const;
+    const unsigned char* data() const;
+    std::size_t size() const;
+
+   private:
+    const unsigned char* mapping{nullptr};
+    std::size_t length{0};
+#ifdef _WIN32
+    void* fileHandle{nullptr};
+    void* mappingHandle{nullptr};
+#endif
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // MAPPED_FILE_H
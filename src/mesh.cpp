@@ -1,24 +1,250 @@
 #include "mesh.h"
 
+#include <algorithm>
+
+#include "geometry_arena.h"
+
 namespace personal::renderer::utility {
 
+namespace {
+
+// drawMulti()'s arrays, kept between calls so drawing every frame doesn't
+// allocate
+struct MultiDrawScratch {
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+};
+thread_local MultiDrawScratch multiDraw;
+
+}  // namespace
+
+std::size_t vertexSize(VertexFormat format) {
+    return format == VertexFormat::Packed ? sizeof(PackedVertex)
+                                          : sizeof(Vertex);
+}
+
+GLenum indexTypeFor(std::size_t vertexCount) {
+    // 0xffff is kept free so the fixed primitive restart index never clashes
+    return vertexCount < 0xffff ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+std::size_t indexSize(GLenum indexType) {
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(std::uint16_t)
+                                          : sizeof(std::uint32_t);
+}
+
+std::vector<std::uint16_t> narrowIndices(
+    const std::vector<unsigned int>& indices) {
+    return std::vector<std::uint16_t>(indices.begin(), indices.end());
+}
+
 Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices,
-           std::vector<Texture> textures)
-    : vertices(vertices), indices(indices), textures(textures) {
-    setupMesh();
+           std::vector<Texture> textures, VertexFormat format,
+           GeometryArena* arena)
+    : vertices(vertices),
+      indices(indices),
+      textures(textures),
+      indexCount(indices.size()),
+      indexType(indexTypeFor(vertices.size())),
+      format(format),
+      bounds(computeBounds(vertices.data(), vertices.size())),
+      sphere(computeBoundingSphere(vertices.data(), vertices.size(),
+                                   bounds)),
+      arena(arena),
+      baseVertex(0),
+      firstIndex(0),
+      lods{MeshLod{0, indexCount, 0.0f}} {
+    // small meshes upload half-size indices
+    std::vector<std::uint16_t> shortIndices;
+    const void* indexData = this->indices.data();
+    if (indexType == GL_UNSIGNED_SHORT) {
+        shortIndices = narrowIndices(this->indices);
+        indexData = shortIndices.data();
+    }
+
+    if (format == VertexFormat::Packed) {
+        std::vector<PackedVertex> packed = packVertices(
+            this->vertices.data(), this->vertices.size(), quantization);
+        setupMesh(packed.data(), packed.size(), indexData);
+    } else {
+        setupMesh(this->vertices.data(), this->vertices.size(), indexData);
+    }
 }
 
-void Mesh::draw(const Shader& shader) const {
+Mesh::Mesh(VertexFormat format, const void* vertexData,
+           std::size_t vertexCount, GLenum indexType, const void* indexData,
+           std::size_t indexCount, std::vector<Texture> textures,
+           const AABB& bounds, const BoundingSphere& sphere,
+           const VertexQuantization& quantization, GeometryArena* arena,
+           std::vector<MeshLod> lods)
+    : textures(textures),
+      indexCount(indexCount),
+      indexType(indexType),
+      format(format),
+      quantization(quantization),
+      bounds(bounds),
+      sphere(sphere),
+      arena(arena),
+      baseVertex(0),
+      firstIndex(0),
+      lods(std::move(lods)) {
+    if (this->lods.empty()) this->lods.push_back(MeshLod{0, indexCount, 0.0f});
+    setupMesh(vertexData, vertexCount, indexData);
+}
+
+const MeshLod& Mesh::lod(std::size_t level) const {
+    return lods[std::min(level, lods.size() - 1)];
+}
+
+void Mesh::draw(const Shader& shader, GLStateTracker* state,
+                std::size_t level) const {
+    bindMaterial(shader, state);
+
+    const MeshLod& range = lod(level);
+    bindVertexArray(state);
+    glDrawElementsBaseVertex(
+        GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), indexType,
+        (void*)((firstIndex + range.firstIndex) * indexSize(indexType)),
+        baseVertex);
+    restoreState(state);
+}
+
+void Mesh::drawInstanced(const Shader& shader, std::size_t instanceCount,
+                         GLStateTracker* state, std::size_t level,
+                         std::size_t baseInstance) const {
+    if (instanceCount == 0) return;
+    bindMaterial(shader, state);
+
+    const MeshLod& range = lod(level);
+    const void* offset =
+        (void*)((firstIndex + range.firstIndex) * indexSize(indexType));
+    bindVertexArray(state);
+    if (baseInstance > 0)
+        glDrawElementsInstancedBaseVertexBaseInstance(
+            GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), indexType,
+            offset, static_cast<GLsizei>(instanceCount), baseVertex,
+            static_cast<GLuint>(baseInstance));
+    else
+        glDrawElementsInstancedBaseVertex(
+            GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), indexType,
+            offset, static_cast<GLsizei>(instanceCount), baseVertex);
+    restoreState(state);
+}
+
+void Mesh::drawIndirect(const Shader& shader, std::size_t offset,
+                        std::size_t drawCount, GLStateTracker* state) const {
+    if (drawCount == 0) return;
+    bindMaterial(shader, state);
+    bindVertexArray(state);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)offset,
+                                static_cast<GLsizei>(drawCount), 0);
+    restoreState(state);
+}
+
+bool Mesh::canBatchWith(const Mesh& other) const {
+    if (VAO != other.VAO || indexType != other.indexType ||
+        textures.size() != other.textures.size())
+        return false;
+    for (std::size_t i = 0; i < textures.size(); ++i)
+        if (textures[i].id != other.textures[i].id ||
+            textures[i].type != other.textures[i].type)
+            return false;
+    // packed meshes set their own dequantization uniforms
+    return format != VertexFormat::Packed ||
+           (quantization.offset == other.quantization.offset &&
+            quantization.scale == other.quantization.scale);
+}
+
+void Mesh::drawMulti(const Shader& shader,
+                     const std::vector<const Mesh*>& meshes,
+                     GLStateTracker* state,
+                     const std::vector<std::uint8_t>* levels) {
+    if (meshes.empty()) return;
+    if (meshes.size() == 1) {
+        meshes[0]->draw(shader, state, levels ? (*levels)[0] : 0);
+        return;
+    }
+
+    const Mesh& first = *meshes[0];
+    std::vector<GLsizei>& counts = multiDraw.counts;
+    std::vector<const void*>& offsets = multiDraw.offsets;
+    std::vector<GLint>& baseVertices = multiDraw.baseVertices;
+    counts.clear();
+    offsets.clear();
+    baseVertices.clear();
+    for (std::size_t i = 0; i < meshes.size(); ++i) {
+        const Mesh* mesh = meshes[i];
+        const MeshLod& range = mesh->lod(levels ? (*levels)[i] : 0);
+        counts.push_back(static_cast<GLsizei>(range.indexCount));
+        offsets.push_back((void*)((mesh->firstIndex + range.firstIndex) *
+                                  indexSize(mesh->indexType)));
+        baseVertices.push_back(mesh->baseVertex);
+    }
+
+    first.bindMaterial(shader, state);
+    first.bindVertexArray(state);
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(),
+                                  first.indexType, offsets.data(),
+                                  static_cast<GLsizei>(meshes.size()),
+                                  baseVertices.data());
+    restoreState(state);
+}
+
+void Mesh::bindMaterial(const Shader& shader, GLStateTracker* state) const {
+    const MaterialBinding& binding = bindingFor(shader);
+
+    for (std::size_t i = 0; i < textures.size(); ++i) {
+        if (binding.samplerUnits[i] < 0) continue;
+        unsigned int unit = static_cast<unsigned int>(binding.samplerUnits[i]);
+        if (state) {
+            state->bindTexture(unit, textures[i].id);
+        } else {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    if (format == VertexFormat::Packed) {
+        glUniform3fv(binding.positionOffsetLocation, 1,
+                     &quantization.offset[0]);
+        glUniform3fv(binding.positionScaleLocation, 1, &quantization.scale[0]);
+    }
+}
+
+void Mesh::bindVertexArray(GLStateTracker* state) const {
+    if (state)
+        state->bindVertexArray(VAO);
+    else
+        glBindVertexArray(VAO);
+}
+
+void Mesh::restoreState(GLStateTracker* state) {
+    // tracked draws leave their bindings for the next draw to reuse
+    if (state) return;
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+const Mesh::MaterialBinding& Mesh::bindingFor(const Shader& shader) const {
+    for (const MaterialBinding& binding : materialBindings)
+        if (binding.program == shader.ID) return binding;
+
+    // first draw with this program: work out the sampler name of every
+    // texture. Each type is numbered sequentially in the shader, e.g.
+    // texture_diffuse1, texture_diffuse2, texture_specular1...
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int normalNr = 1;
     unsigned int heightNr = 1;
 
-    for (long long unsigned int i = 0; i < textures.size(); ++i) {
-        glActiveTexture(GL_TEXTURE0 + static_cast<int>(i));
-
+    MaterialBinding binding{shader.ID, {},
+                            shader.uniformLocation("positionOffset"),
+                            shader.uniformLocation("positionScale")};
+    binding.samplerUnits.reserve(textures.size());
+    for (const Texture& texture : textures) {
         std::string number;
-        std::string name = textures[i].type;
+        const std::string& name = texture.type;
 
         if (name == "texture_diffuse")
             number = std::to_string(diffuseNr++);
@@ -29,21 +255,30 @@ void Mesh::draw(const Shader& shader) const {
         else if (name == "texture_height")
             number = std::to_string(heightNr++);
 
-        glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()),
-                    static_cast<int>(i));
-
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        int location = shader.uniformLocation(name + number);
+        GLint unit = -1;
+        if (location >= 0) glGetUniformiv(shader.ID, location, &unit);
+        binding.samplerUnits.push_back(unit);
     }
 
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()),
-                   GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    glActiveTexture(GL_TEXTURE0);
+    materialBindings.push_back(std::move(binding));
+    return materialBindings.back();
 }
 
-void Mesh::setupMesh() {
+void Mesh::setupMesh(const void* vertexData, std::size_t vertexCount,
+                     const void* indexData) {
+    if (arena) {
+        GeometryRange range = arena->allocate(format, indexType, vertexData,
+                                              vertexCount, indexData,
+                                              indexCount);
+        VAO = range.vertexArray;
+        VBO = 0;
+        EBO = 0;
+        baseVertex = range.baseVertex;
+        firstIndex = range.firstIndex;
+        return;
+    }
+
     // create buffers/arrays
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -56,12 +291,40 @@ void Mesh::setupMesh() {
     // all its items. The effect is that we can simply pass a pointer to the
     // struct and it translates perfectly to a glm::vec3/2 array which again
     // translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-                 &vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * vertexSize(format), vertexData,
+                 GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-                 &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize(indexType),
+                 indexData, GL_STATIC_DRAW);
+
+    setVertexAttributes(format);
+    glBindVertexArray(0);
+}
+
+void setVertexAttributes(VertexFormat format) {
+    if (format == VertexFormat::Packed) {
+        // same attribute locations as the standard layout, but normalized
+        // integer and half float data that shaders/packed.vert decodes.
+        // vertex Positions (snorm16, relative to the bounding box)
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(PackedVertex),
+                              (void*)offsetof(PackedVertex, position));
+        // vertex texture coords (half float)
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE,
+                              sizeof(PackedVertex),
+                              (void*)offsetof(PackedVertex, texCoords));
+        // vertex normals (octahedral snorm16)
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex),
+                              (void*)offsetof(PackedVertex, normal));
+        // vertex tangent (octahedral snorm16, bitangent sign in y)
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex),
+                              (void*)offsetof(PackedVertex, tangent));
+        return;
+    }
 
     // set the vertex attribute pointers
     // vertex Positions
@@ -92,6 +355,5 @@ void Mesh::setupMesh() {
     glEnableVertexAttribArray(6);
     glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
                           (void*)offsetof(Vertex, m_Weights));
-    glBindVertexArray(0);
 }
 }  // namespace personal::renderer::utility
\ No newline at end of file
@@ -3,12 +3,17 @@
 
 #include <glad/glad.h>
 
+#include <cstddef>
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <string>
 #include <vector>
 
+#include "culling.h"
+#include "gl_state.h"
 #include "shader.h"
+#include "vertex_packing.h"
 
 #define MAX_BONE_INFLUENCE 4
 
@@ -24,28 +29,140 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// Layout of the vertex data a mesh keeps on the GPU
+enum class VertexFormat : std::uint32_t {
+    // full precision Vertex, including the bone attributes
+    Standard,
+    // quantized PackedVertex for static meshes, see vertex_packing.h. Has to
+    // be drawn with a shader that decodes it, like shaders/packed.vert.
+    Packed
+};
+
 struct Texture {
     unsigned int id;
     std::string type;
     std::string path;
 };
 
+// One level of detail of a mesh: the range of its index buffer drawing a
+// simplified version of it, and how far, in object space units, that
+// deviates from the full detail mesh
+struct MeshLod {
+    std::size_t firstIndex{0};
+    std::size_t indexCount{0};
+    float error{0.0f};
+};
+
+class GeometryArena;
+
+std::size_t vertexSize(VertexFormat format);
+// points the vertex attributes of the bound VAO at the bound GL_ARRAY_BUFFER,
+// laid out as the given format
+void setVertexAttributes(VertexFormat format);
+
+// GL_UNSIGNED_SHORT when every vertex of the mesh can be addressed with 16
+// bits, GL_UNSIGNED_INT otherwise
+GLenum indexTypeFor(std::size_t vertexCount);
+std::size_t indexSize(GLenum indexType);
+std::vector<std::uint16_t> narrowIndices(const std::vector<unsigned int>& indices);
+
 class Mesh {
    public:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
     unsigned int VAO;
+    // every index uploaded, over all levels of detail
+    std::size_t indexCount;
+    GLenum indexType;
+    VertexFormat format;
+    // only meaningful for VertexFormat::Packed
+    VertexQuantization quantization;
+    // object space bounds of the vertices, computed on import
+    AABB bounds;
+    BoundingSphere sphere;
+    // arena the geometry was suballocated from, or nullptr if the mesh owns
+    // its buffers. Arena meshes share their VAO with the rest of the pool and
+    // are drawn from their range of it.
+    GeometryArena* arena;
+    int baseVertex;
+    std::size_t firstIndex;
+    // full detail first, then ever coarser levels sharing the vertices.
+    // Always holds at least the full detail level.
+    std::vector<MeshLod> lods;
 
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices,
-         std::vector<Texture> textures);
-    void draw(const Shader& shader) const;
+         std::vector<Texture> textures,
+         VertexFormat format = VertexFormat::Standard,
+         GeometryArena* arena = nullptr);
+    // uploads vertex and index data that is already in its final format
+    // straight to the GPU without keeping a CPU-side copy, used for meshes
+    // coming out of the mesh cache
+    Mesh(VertexFormat format, const void* vertexData, std::size_t vertexCount,
+         GLenum indexType, const void* indexData, std::size_t indexCount,
+         std::vector<Texture> textures, const AABB& bounds,
+         const BoundingSphere& sphere,
+         const VertexQuantization& quantization = {},
+         GeometryArena* arena = nullptr, std::vector<MeshLod> lods = {});
+    // the given level of detail, or the coarsest one if there are fewer
+    const MeshLod& lod(std::size_t level) const;
+
+    // Drawing binds through state when one is given, and then leaves the
+    // VAO and textures bound so following tracked draws can skip rebinding
+    // them. Without one the bindings are reset after the draw.
+    void draw(const Shader& shader, GLStateTracker* state = nullptr,
+              std::size_t level = 0) const;
+    // draws instanceCount instances in one call. Per-instance attributes have
+    // to be set up on the VAO beforehand, see InstancedModel. A baseInstance
+    // other than 0 needs GL 4.2.
+    void drawInstanced(const Shader& shader, std::size_t instanceCount,
+                       GLStateTracker* state = nullptr, std::size_t level = 0,
+                       std::size_t baseInstance = 0) const;
+    // draws drawCount DrawElementsIndirectCommands from the bound
+    // GL_DRAW_INDIRECT_BUFFER, starting offset bytes in, with one
+    // glMultiDrawElementsIndirect. Their first index and base vertex are
+    // into the whole index and vertex buffer, so they have to include the
+    // mesh's own firstIndex and baseVertex. Needs GL 4.3.
+    void drawIndirect(const Shader& shader, std::size_t offset,
+                      std::size_t drawCount,
+                      GLStateTracker* state = nullptr) const;
+
+    // whether both meshes can be drawn by one multi-draw call: same vertex
+    // array and index type, and identical textures and per-mesh uniforms
+    bool canBatchWith(const Mesh& other) const;
+    // draws meshes that can all be batched with the first one, using a single
+    // glMultiDrawElementsBaseVertex call. levels holds each mesh's level of
+    // detail; without it they're all drawn at full detail.
+    static void drawMulti(const Shader& shader,
+                          const std::vector<const Mesh*>& meshes,
+                          GLStateTracker* state = nullptr,
+                          const std::vector<std::uint8_t>* levels = nullptr);
 
    private:
     unsigned int VBO;
     unsigned int EBO;
 
-    void setupMesh();
+    // uniform locations the mesh sets when drawn, resolved for one program
+    struct MaterialBinding {
+        unsigned int program;
+        // the unit the program samples each texture from, or -1 if it
+        // doesn't use the texture. Fixed when the program is reflected.
+        std::vector<int> samplerUnits;
+        int positionOffsetLocation;
+        int positionScaleLocation;
+    };
+    // resolved lazily the first time the mesh is drawn with each program, so
+    // drawing never has to build sampler names or look up locations
+    mutable std::vector<MaterialBinding> materialBindings;
+
+    const MaterialBinding& bindingFor(const Shader& shader) const;
+    // binds the mesh's textures and sets its per-mesh uniforms
+    void bindMaterial(const Shader& shader, GLStateTracker* state) const;
+    void bindVertexArray(GLStateTracker* state) const;
+    static void restoreState(GLStateTracker* state);
+
+    void setupMesh(const void* vertexData, std::size_t vertexCount,
+                   const void* indexData);
 };
 
 }  // namespace personal::renderer::utility
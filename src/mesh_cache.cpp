@@ -0,0 +1,345 @@
+#include "mesh_cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace personal::renderer::utility {
+
+namespace {
+
+const char MAGIC[4] = {'L', 'O', 'M', 'C'};
+// vertex and index blobs start on this boundary so they can be read in place
+const std::size_t BLOB_ALIGNMENT = 16;
+
+struct FileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t importFlags;
+    std::uint32_t vertexSize;
+    std::int64_t sourceTime;
+    std::uint64_t sourceSize;
+    std::uint32_t meshCount;
+    std::uint32_t vertexFormat;
+    std::uint32_t processing;
+    std::uint32_t padding;
+};
+
+struct MeshHeader {
+    std::uint64_t vertexCount;
+    std::uint64_t indexCount;
+    std::uint32_t textureCount;
+    std::uint32_t indexType;
+    std::uint32_t lodCount;
+    std::uint32_t padding;
+    float positionOffset[3];
+    float positionScale[3];
+    float boundsMin[3];
+    float boundsMax[3];
+    float sphereCenter[3];
+    float sphereRadius;
+};
+
+struct LodHeader {
+    std::uint64_t firstIndex;
+    std::uint64_t indexCount;
+    float error;
+    std::uint32_t padding;
+};
+
+// import options that change the processed mesh data, as bits
+const std::uint32_t PROCESSING_OPTIMIZE_INDICES = 1u << 0;
+const std::uint32_t PROCESSING_OPTIMIZE_OVERDRAW = 1u << 1;
+const std::uint32_t PROCESSING_GENERATE_LODS = 1u << 2;
+
+std::uint32_t processingBits(const ImportOptions& options) {
+    std::uint32_t bits = 0;
+    if (options.optimizeIndices) bits |= PROCESSING_OPTIMIZE_INDICES;
+    if (options.optimizeOverdraw) bits |= PROCESSING_OPTIMIZE_OVERDRAW;
+    if (options.generateLods) bits |= PROCESSING_GENERATE_LODS;
+    return bits;
+}
+
+// identifies the exact version of the source file the cache was built from
+bool sourceStamp(const std::string& path, std::int64_t& time,
+                 std::uint64_t& size) {
+    std::error_code error;
+    auto lastWrite = std::filesystem::last_write_time(path, error);
+    if (error) return false;
+    auto fileSize = std::filesystem::file_size(path, error);
+    if (error) return false;
+
+    time = static_cast<std::int64_t>(lastWrite.time_since_epoch().count());
+    size = static_cast<std::uint64_t>(fileSize);
+    return true;
+}
+
+std::size_t alignUp(std::size_t value, std::size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// bounds checked cursor over the mapped cache file
+class Reader {
+   public:
+    Reader(const unsigned char* data, std::size_t size)
+        : data(data), size(size) {}
+
+    template <typename T>
+    bool read(T& out) {
+        if (size - offset < sizeof(T)) return false;
+        std::memcpy(&out, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    bool readString(std::string& out) {
+        std::uint32_t length;
+        if (!read(length) || size - offset < length) return false;
+        out.assign(reinterpret_cast<const char*>(data + offset), length);
+        offset += length;
+        return true;
+    }
+
+    // returns an aligned, in-place view of count elements of elementSize
+    const unsigned char* take(std::uint64_t count, std::size_t elementSize) {
+        offset = alignUp(offset, BLOB_ALIGNMENT);
+        if (offset > size || count > (size - offset) / elementSize)
+            return nullptr;
+        const unsigned char* blob = data + offset;
+        offset += static_cast<std::size_t>(count) * elementSize;
+        return blob;
+    }
+
+   private:
+    const unsigned char* data;
+    std::size_t size;
+    std::size_t offset{0};
+};
+
+class Writer {
+   public:
+    explicit Writer(std::ofstream& stream) : stream(stream) {}
+
+    template <typename T>
+    void write(const T& value) {
+        writeBytes(&value, sizeof(T));
+    }
+
+    void writeString(const std::string& value) {
+        write(static_cast<std::uint32_t>(value.size()));
+        writeBytes(value.data(), value.size());
+    }
+
+    void writeBlob(const void* bytes, std::size_t count) {
+        static const char zeros[BLOB_ALIGNMENT] = {};
+        writeBytes(zeros, alignUp(offset, BLOB_ALIGNMENT) - offset);
+        writeBytes(bytes, count);
+    }
+
+   private:
+    std::ofstream& stream;
+    std::size_t offset{0};
+
+    void writeBytes(const void* bytes, std::size_t count) {
+        stream.write(static_cast<const char*>(bytes),
+                     static_cast<std::streamsize>(count));
+        offset += count;
+    }
+};
+
+}  // namespace
+
+MeshCache::MeshCache(const std::string& sourcePath, std::uint32_t importFlags,
+                     const ImportOptions& options)
+    : sourcePath(sourcePath),
+      cachePath(sourcePath + ".meshcache"),
+      importFlags(importFlags),
+      options(options) {}
+
+bool MeshCache::load() {
+    cachedMeshes.clear();
+
+    std::int64_t sourceTime;
+    std::uint64_t sourceSize;
+    if (!sourceStamp(sourcePath, sourceTime, sourceSize)) return false;
+
+    file = std::make_unique<MappedFile>(cachePath);
+    if (!file->isOpen()) return false;
+
+    Reader reader(file->data(), file->size());
+    VertexFormat format = options.vertexFormat;
+
+    // reject anything that was not built for exactly this source and
+    // these import settings
+    FileHeader header;
+    std::string path;
+    if (!reader.read(header) ||
+        std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != MESH_CACHE_VERSION ||
+        header.importFlags != importFlags ||
+        header.vertexFormat != static_cast<std::uint32_t>(format) ||
+        header.processing != processingBits(options) ||
+        header.vertexSize != vertexSize(format) ||
+        header.sourceTime != sourceTime || header.sourceSize != sourceSize ||
+        !reader.readString(path) || path != sourcePath) {
+        file.reset();
+        return false;
+    }
+
+    cachedMeshes.reserve(header.meshCount);
+    for (std::uint32_t i = 0; i < header.meshCount; ++i) {
+        MeshHeader meshHeader;
+        CachedMesh mesh;
+        bool ok = reader.read(meshHeader);
+
+        for (std::uint32_t t = 0; ok && t < meshHeader.textureCount; ++t) {
+            CachedTexture texture;
+            ok = reader.readString(texture.type) &&
+                 reader.readString(texture.path);
+            mesh.textures.push_back(texture);
+        }
+        for (std::uint32_t l = 0; ok && l < meshHeader.lodCount; ++l) {
+            LodHeader lodHeader;
+            ok = reader.read(lodHeader) &&
+                 lodHeader.firstIndex + lodHeader.indexCount <=
+                     meshHeader.indexCount;
+            mesh.lods.push_back(
+                MeshLod{static_cast<std::size_t>(lodHeader.firstIndex),
+                        static_cast<std::size_t>(lodHeader.indexCount),
+                        lodHeader.error});
+        }
+
+        const unsigned char* vertexBlob =
+            ok ? reader.take(meshHeader.vertexCount, vertexSize(format))
+               : nullptr;
+        GLenum indexType = meshHeader.indexType;
+        bool validIndexType =
+            indexType == GL_UNSIGNED_SHORT || indexType == GL_UNSIGNED_INT;
+        const unsigned char* indexBlob =
+            vertexBlob && validIndexType
+                ? reader.take(meshHeader.indexCount, indexSize(indexType))
+                : nullptr;
+
+        if (!indexBlob) {
+            std::cout << "ERROR::MESH_CACHE::CORRUPT_FILE: " << cachePath
+                      << '\n';
+            cachedMeshes.clear();
+            file.reset();
+            return false;
+        }
+
+        mesh.vertices = vertexBlob;
+        mesh.vertexCount = static_cast<std::size_t>(meshHeader.vertexCount);
+        mesh.indexType = indexType;
+        mesh.indices = indexBlob;
+        mesh.indexCount = static_cast<std::size_t>(meshHeader.indexCount);
+        mesh.quantization.offset =
+            glm::vec3(meshHeader.positionOffset[0],
+                      meshHeader.positionOffset[1],
+                      meshHeader.positionOffset[2]);
+        mesh.quantization.scale = glm::vec3(meshHeader.positionScale[0],
+                                            meshHeader.positionScale[1],
+                                            meshHeader.positionScale[2]);
+        for (int axis = 0; axis < 3; ++axis) {
+            mesh.bounds.min[axis] = meshHeader.boundsMin[axis];
+            mesh.bounds.max[axis] = meshHeader.boundsMax[axis];
+            mesh.sphere.center[axis] = meshHeader.sphereCenter[axis];
+        }
+        mesh.sphere.radius = meshHeader.sphereRadius;
+        cachedMeshes.push_back(std::move(mesh));
+    }
+
+    return true;
+}
+
+const std::vector<CachedMesh>& MeshCache::meshes() const {
+    return cachedMeshes;
+}
+
+bool MeshCache::write(const std::vector<ImportedMesh>& meshes) const {
+    VertexFormat format = options.vertexFormat;
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = MESH_CACHE_VERSION;
+    header.importFlags = importFlags;
+    header.vertexSize = static_cast<std::uint32_t>(vertexSize(format));
+    header.vertexFormat = static_cast<std::uint32_t>(format);
+    header.processing = processingBits(options);
+    header.meshCount = static_cast<std::uint32_t>(meshes.size());
+    if (!sourceStamp(sourcePath, header.sourceTime, header.sourceSize))
+        return false;
+
+    // write to a temporary file first so a crash mid-write can never leave a
+    // truncated cache behind that would later be picked up as valid
+    std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            std::cout << "ERROR::MESH_CACHE::FILE_NOT_WRITABLE: " << tempPath
+                      << '\n';
+            return false;
+        }
+
+        Writer writer(stream);
+        writer.write(header);
+        writer.writeString(sourcePath);
+
+        for (const ImportedMesh& mesh : meshes) {
+            MeshHeader meshHeader{};
+            meshHeader.vertexCount = mesh.vertexCount;
+            meshHeader.indexCount = mesh.indexCount;
+            meshHeader.textureCount =
+                static_cast<std::uint32_t>(mesh.textures.size());
+            meshHeader.indexType = mesh.indexType;
+            meshHeader.lodCount = static_cast<std::uint32_t>(mesh.lods.size());
+            for (int axis = 0; axis < 3; ++axis) {
+                meshHeader.positionOffset[axis] =
+                    mesh.quantization.offset[axis];
+                meshHeader.positionScale[axis] = mesh.quantization.scale[axis];
+                meshHeader.boundsMin[axis] = mesh.bounds.min[axis];
+                meshHeader.boundsMax[axis] = mesh.bounds.max[axis];
+                meshHeader.sphereCenter[axis] = mesh.sphere.center[axis];
+            }
+            meshHeader.sphereRadius = mesh.sphere.radius;
+            writer.write(meshHeader);
+
+            for (const Texture& texture : mesh.textures) {
+                writer.writeString(texture.type);
+                writer.writeString(texture.path);
+            }
+            for (const MeshLod& lod : mesh.lods) {
+                LodHeader lodHeader{};
+                lodHeader.firstIndex = lod.firstIndex;
+                lodHeader.indexCount = lod.indexCount;
+                lodHeader.error = lod.error;
+                writer.write(lodHeader);
+            }
+
+            // the vertices and indices are stored exactly as they're
+            // uploaded, so a warm start doesn't have to convert them again
+            writer.writeBlob(mesh.vertexData,
+                             mesh.vertexCount * vertexSize(format));
+            writer.writeBlob(mesh.indexData,
+                             mesh.indexCount * indexSize(mesh.indexType));
+        }
+
+        if (!stream) {
+            std::cout << "ERROR::MESH_CACHE::WRITE_FAILED: " << tempPath
+                      << '\n';
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error) {
+        std::cout << "ERROR::MESH_CACHE::WRITE_FAILED: " << cachePath << ": "
+                  << error.message() << '\n';
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+    return true;
+}
+
+}  // namespace personal::renderer::utility
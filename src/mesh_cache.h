@@ -0,0 +1,73 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "mesh.h"
+#include "model.h"
+
+namespace personal::renderer::utility {
+
+// Bump whenever the on-disk layout, the Vertex struct or what an import
+// produces changes
+const std::uint32_t MESH_CACHE_VERSION = 6;
+
+struct CachedTexture {
+    std::string type;
+    std::string path;
+};
+
+// A mesh as stored in the cache. The vertex and index pointers point directly
+// into the mapped cache file and are only valid while the owning MeshCache is
+// alive. Vertices are in the format the cache was opened with.
+struct CachedMesh {
+    const void* vertices;
+    std::size_t vertexCount;
+    GLenum indexType;
+    const void* indices;
+    std::size_t indexCount;
+    VertexQuantization quantization;
+    AABB bounds;
+    BoundingSphere sphere;
+    std::vector<MeshLod> lods;
+    std::vector<CachedTexture> textures;
+};
+
+// Binary cache of fully processed meshes, stored next to the source model as
+// '<model path>.meshcache'. A cache file is only considered valid if it was
+// written for the same source path, source modification time, source size,
+// assimp import flags and import options as the current request, so editing a
+// model or changing the import options transparently falls back to a full
+// import.
+class MeshCache {
+   public:
+    std::string sourcePath;
+    std::string cachePath;
+
+    MeshCache(const std::string& sourcePath, std::uint32_t importFlags,
+              const ImportOptions& options);
+
+    // maps the cache file and validates its header. Returns false if there is
+    // no usable cache for the source model.
+    bool load();
+    const std::vector<CachedMesh>& meshes() const;
+
+    // writes the given meshes out as the cache for the source model. The
+    // meshes must not have been released yet.
+    bool write(const std::vector<ImportedMesh>& meshes) const;
+
+   private:
+    std::uint32_t importFlags;
+    ImportOptions options;
+    std::unique_ptr<MappedFile> file;
+    std::vector<CachedMesh> cachedMeshes;
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // MESH_CACHE_H
@@ -0,0 +1,307 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// LRU cache modelled by the Forsyth scoring function
+const int FORSYTH_CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+float vertexScore(int cachePosition, unsigned int remainingTriangles) {
+    // no triangles left to draw, so never worth picking
+    if (remainingTriangles == 0) return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // used by the last triangle: fixed score, so the optimiser
+            // doesn't always prefer continuing the same strip
+            score = LAST_TRIANGLE_SCORE;
+        } else {
+            float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+            score = 1.0f - static_cast<float>(cachePosition - 3) * scaler;
+            score = std::pow(score, CACHE_DECAY_POWER);
+        }
+    }
+    // boost vertices with few triangles left, to finish them off and avoid
+    // leaving lone triangles behind
+    score += VALENCE_BOOST_SCALE *
+             std::pow(static_cast<float>(remainingTriangles),
+                      -VALENCE_BOOST_POWER);
+    return score;
+}
+
+// simulates a FIFO cache of cacheSize entries over count indices, returning
+// the number of misses. A vertex is in the cache if it was added less than
+// cacheSize insertions ago; bumping timestamp by cacheSize + 1 flushes it.
+unsigned int cacheMisses(const unsigned int* indices, std::size_t count,
+                         std::vector<unsigned int>& cacheTimestamps,
+                         unsigned int& timestamp, unsigned int cacheSize) {
+    unsigned int misses = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        unsigned int v = indices[i];
+        if (timestamp - cacheTimestamps[v] > cacheSize) {
+            cacheTimestamps[v] = timestamp++;
+            ++misses;
+        }
+    }
+    return misses;
+}
+
+// number of cache misses of every triangle, in order
+std::vector<unsigned char> triangleMisses(
+    const std::vector<unsigned int>& indices,
+    std::vector<unsigned int>& cacheTimestamps, unsigned int& timestamp,
+    unsigned int cacheSize) {
+    std::vector<unsigned char> misses(indices.size() / 3);
+    for (std::size_t t = 0; t < misses.size(); ++t)
+        misses[t] = static_cast<unsigned char>(cacheMisses(
+            &indices[t * 3], 3, cacheTimestamps, timestamp, cacheSize));
+    return misses;
+}
+
+}  // namespace
+
+float averageCacheMissRatio(const std::vector<unsigned int>& indices,
+                            std::size_t vertexCount, unsigned int cacheSize) {
+    if (indices.size() < 3) return 0.0f;
+
+    // timestamps start far enough in the past to count as misses
+    std::vector<unsigned int> cacheTimestamps(vertexCount, 0);
+    unsigned int timestamp = cacheSize + 1;
+    unsigned int misses = cacheMisses(indices.data(), indices.size(),
+                                      cacheTimestamps, timestamp, cacheSize);
+    return static_cast<float>(misses) /
+           static_cast<float>(indices.size() / 3);
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices,
+                         std::size_t vertexCount) {
+    std::size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // triangles using each vertex, as spans into one flat adjacency array.
+    // Each span is kept partitioned so its first remaining[v] entries are the
+    // triangles still to be emitted.
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices) ++remaining[index];
+
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill(adjacencyOffset.begin(),
+                                       adjacencyOffset.end() - 1);
+        for (std::size_t t = 0; t < triangleCount; ++t)
+            for (int k = 0; k < 3; ++k)
+                adjacency[fill[indices[t * 3 + k]]++] =
+                    static_cast<unsigned int>(t);
+    }
+
+    std::vector<float> scores(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        scores[v] = vertexScore(-1, remaining[v]);
+
+    // start from the best scoring triangle overall
+    std::vector<bool> emitted(triangleCount, false);
+    std::size_t best = 0;
+    float bestScore = -1.0f;
+    for (std::size_t t = 0; t < triangleCount; ++t) {
+        float score = scores[indices[t * 3]] + scores[indices[t * 3 + 1]] +
+                      scores[indices[t * 3 + 2]];
+        if (score > bestScore) {
+            bestScore = score;
+            best = t;
+        }
+    }
+
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> newCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    std::size_t cursor = 0;
+
+    for (std::size_t emittedCount = 0; emittedCount < triangleCount;
+         ++emittedCount) {
+        // nothing useful in the cache: carry on with the next triangle in
+        // the original order
+        if (best == triangleCount) {
+            while (emitted[cursor]) ++cursor;
+            best = cursor;
+        }
+
+        const unsigned int* triangle = &indices[best * 3];
+        result.insert(result.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        // retire the triangle from its vertices' spans and put the vertices
+        // at the front of the cache
+        newCache.clear();
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = triangle[k];
+            unsigned int* span = &adjacency[adjacencyOffset[v]];
+            unsigned int* end = span + remaining[v];
+            std::iter_swap(std::find(span, end, best), end - 1);
+            --remaining[v];
+            newCache.push_back(v);
+        }
+        for (unsigned int v : cache)
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache.push_back(v);
+
+        // vertices pushed out of the cache lose their cache score
+        for (std::size_t i = FORSYTH_CACHE_SIZE; i < newCache.size(); ++i)
+            scores[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+        if (newCache.size() > static_cast<std::size_t>(FORSYTH_CACHE_SIZE))
+            newCache.resize(FORSYTH_CACHE_SIZE);
+        std::swap(cache, newCache);
+
+        for (std::size_t i = 0; i < cache.size(); ++i)
+            scores[cache[i]] =
+                vertexScore(static_cast<int>(i), remaining[cache[i]]);
+
+        // rescore the triangles touching the cache and pick the best one
+        best = triangleCount;
+        bestScore = -1.0f;
+        for (unsigned int v : cache) {
+            const unsigned int* span = &adjacency[adjacencyOffset[v]];
+            for (unsigned int i = 0; i < remaining[v]; ++i) {
+                unsigned int t = span[i];
+                float score = scores[indices[t * 3]] +
+                              scores[indices[t * 3 + 1]] +
+                              scores[indices[t * 3 + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices,
+                      const std::vector<Vertex>& vertices, float threshold) {
+    std::size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    std::vector<unsigned int> cacheTimestamps(vertices.size(), 0);
+    unsigned int timestamp = VERTEX_CACHE_SIZE + 1;
+
+    // hard boundaries: triangles where all three vertices miss, i.e. where
+    // the cache optimiser started over
+    std::vector<unsigned char> misses = triangleMisses(
+        indices, cacheTimestamps, timestamp, VERTEX_CACHE_SIZE);
+    std::vector<std::size_t> hardBoundaries;
+    for (std::size_t t = 0; t < triangleCount; ++t)
+        if (t == 0 || misses[t] == 3) hardBoundaries.push_back(t);
+    hardBoundaries.push_back(triangleCount);
+
+    // soft boundaries: split hard clusters further wherever the part so far
+    // already has an ACMR within threshold of the whole cluster's. Every
+    // split flushes the cache, which is what bounds the efficiency loss.
+    std::vector<std::size_t> clusters;
+    for (std::size_t h = 0; h + 1 < hardBoundaries.size(); ++h) {
+        std::size_t start = hardBoundaries[h];
+        std::size_t end = hardBoundaries[h + 1];
+
+        std::size_t clusterMisses = 0;
+        for (std::size_t t = start; t < end; ++t) clusterMisses += misses[t];
+        float clusterAcmr = static_cast<float>(clusterMisses) /
+                            static_cast<float>(end - start);
+
+        timestamp += VERTEX_CACHE_SIZE + 1;
+        std::size_t partStart = start;
+        std::size_t partMisses = 0;
+        clusters.push_back(start);
+        for (std::size_t t = start; t < end; ++t) {
+            partMisses += cacheMisses(&indices[t * 3], 3, cacheTimestamps,
+                                      timestamp, VERTEX_CACHE_SIZE);
+
+            float partAcmr = static_cast<float>(partMisses) /
+                             static_cast<float>(t + 1 - partStart);
+            if (t + 1 < end && partAcmr <= clusterAcmr * threshold) {
+                clusters.push_back(t + 1);
+                partStart = t + 1;
+                partMisses = 0;
+                timestamp += VERTEX_CACHE_SIZE + 1;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // sort key: how much each cluster faces away from the mesh centre
+    glm::vec3 meshCentroid(0.0f);
+    for (const Vertex& vertex : vertices) meshCentroid += vertex.position;
+    meshCentroid /= static_cast<float>(std::max<std::size_t>(vertices.size(), 1));
+
+    std::size_t clusterCount = clusters.size() - 1;
+    std::vector<float> sortKeys(clusterCount);
+    for (std::size_t c = 0; c < clusterCount; ++c) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (std::size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+            const glm::vec3& a = vertices[indices[t * 3]].position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3& d = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float triangleArea = glm::length(n);
+            centroid += (a + b + d) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+        if (area > 0.0f) centroid /= area;
+        float normalLength = glm::length(normal);
+        if (normalLength > 0.0f) normal /= normalLength;
+        sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+    }
+
+    std::vector<std::size_t> order(clusterCount);
+    for (std::size_t c = 0; c < clusterCount; ++c) order[c] = c;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::size_t a, std::size_t b) {
+                         return sortKeys[a] > sortKeys[b];
+                     });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (std::size_t c : order)
+        result.insert(result.end(), indices.begin() + clusters[c] * 3,
+                      indices.begin() + clusters[c + 1] * 3);
+    indices.swap(result);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices,
+                         std::vector<unsigned int>& indices) {
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+    for (unsigned int& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<unsigned int>(result.size());
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+}
+
+}  // namespace personal::renderer::utility
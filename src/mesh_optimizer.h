@@ -0,0 +1,45 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.h"
+
+namespace personal::renderer::utility {
+
+// Size of the FIFO post-transform cache used to measure index buffers. Small
+// enough to be representative of older hardware, which keeps the orderings
+// good on everything newer.
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+// Average cache miss ratio: vertex shader invocations per triangle for a FIFO
+// cache of cacheSize entries. 3.0 is the worst case, ~0.5-0.7 is excellent.
+float averageCacheMissRatio(const std::vector<unsigned int>& indices,
+                            std::size_t vertexCount,
+                            unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders triangles for post-transform vertex cache locality using Tom
+// Forsyth's "Linear-Speed Vertex Cache Optimisation".
+void optimizeVertexCache(std::vector<unsigned int>& indices,
+                         std::size_t vertexCount);
+
+// Splits an index buffer that has already been cache optimized into clusters
+// at the points where the cache restarts, then orders the clusters so the ones
+// facing outwards from the mesh centre are drawn first, which reduces overdraw
+// from most view directions (Sander et al., "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw"). Cache efficiency stays close to the
+// input's, bounded by threshold times its ACMR.
+void optimizeOverdraw(std::vector<unsigned int>& indices,
+                      const std::vector<Vertex>& vertices,
+                      float threshold = 1.05f);
+
+// Reorders vertices into the order they are first referenced by the index
+// buffer so the vertex fetch walks memory linearly, and remaps the indices.
+// Vertices that are never referenced are dropped.
+void optimizeVertexFetch(std::vector<Vertex>& vertices,
+                         std::vector<unsigned int>& indices);
+
+}  // namespace personal::renderer::utility
+
+#endif  // MESH_OPTIMIZER_H
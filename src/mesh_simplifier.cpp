@@ -0,0 +1,538 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+
+#include "mesh_optimizer.h"
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// borders and seams are held in place by planes through their edges,
+// perpendicular to the surface, weighted this much more than the surface
+const double BORDER_WEIGHT = 10.0;
+// cosine of the largest rotation a collapse may give a triangle's normal
+const float MIN_NORMAL_COSINE = 0.25f;
+// a level has to drop at least a tenth of the previous one's triangles to be
+// worth keeping
+const float MAX_LEVEL_RATIO = 0.9f;
+
+const unsigned int NO_VERTEX = ~0u;
+
+enum class VertexKind : std::uint8_t {
+    // inside the surface, collapses into any neighbour
+    Manifold,
+    // on an open border, only collapses along it
+    Border,
+    // one side of a normal or texture coordinate seam, only collapses along
+    // the seam, together with the other side
+    Seam,
+    // corners and anything more complicated, never collapses
+    Locked
+};
+
+// a sum of squared distances to weighted planes, as a symmetric 4x4 matrix,
+// and the sum of the weights
+struct Quadric {
+    double xx{0.0}, yy{0.0}, zz{0.0}, xy{0.0}, xz{0.0}, yz{0.0};
+    double xw{0.0}, yw{0.0}, zw{0.0}, ww{0.0};
+    double weight{0.0};
+
+    // adds the plane through point with the given unit normal
+    void addPlane(const glm::vec3& normal, const glm::vec3& point,
+                  double planeWeight) {
+        double a = normal.x, b = normal.y, c = normal.z;
+        double d = -(a * point.x + b * point.y + c * point.z);
+        xx += planeWeight * a * a;
+        yy += planeWeight * b * b;
+        zz += planeWeight * c * c;
+        xy += planeWeight * a * b;
+        xz += planeWeight * a * c;
+        yz += planeWeight * b * c;
+        xw += planeWeight * a * d;
+        yw += planeWeight * b * d;
+        zw += planeWeight * c * d;
+        ww += planeWeight * d * d;
+        weight += planeWeight;
+    }
+
+    void add(const Quadric& other) {
+        xx += other.xx;
+        yy += other.yy;
+        zz += other.zz;
+        xy += other.xy;
+        xz += other.xz;
+        yz += other.yz;
+        xw += other.xw;
+        yw += other.yw;
+        zw += other.zw;
+        ww += other.ww;
+        weight += other.weight;
+    }
+
+    // weighted mean of the squared distances from the point to the planes
+    double error(const glm::vec3& point) const {
+        if (weight <= 0.0) return 0.0;
+        double x = point.x, y = point.y, z = point.z;
+        double sum = xx * x * x + yy * y * y + zz * z * z +
+                     2.0 * (xy * x * y + xz * x * z + yz * y * z + xw * x +
+                            yw * y + zw * z) +
+                     ww;
+        return std::max(sum, 0.0) / weight;
+    }
+};
+
+// the exact bits of the attributes that tell vertices apart, position first
+// so sorting by them groups the vertices sharing a position
+struct VertexKey {
+    std::uint32_t bits[8];
+};
+
+const std::size_t POSITION_KEY_SIZE = 3 * sizeof(std::uint32_t);
+
+VertexKey makeKey(const Vertex& vertex) {
+    const float values[8] = {vertex.position.x,  vertex.position.y,
+                             vertex.position.z,  vertex.normal.x,
+                             vertex.normal.y,    vertex.normal.z,
+                             vertex.texCoords.x, vertex.texCoords.y};
+    VertexKey key;
+    std::memcpy(key.bits, values, sizeof(values));
+    return key;
+}
+
+// Collapses edges of one triangle list over several passes. Each pass
+// performs the cheapest collapses that don't touch each other, locking the
+// vertices around every collapse so the checks of the following ones still
+// see the geometry they will change.
+class Simplifier {
+   public:
+    // the current triangles, indexing the input's vertices
+    std::vector<unsigned int> indices;
+    // largest error of any collapse so far
+    float error{0.0f};
+
+    Simplifier(const std::vector<unsigned int>& source,
+               const std::vector<Vertex>& vertices);
+
+    // collapses until at most targetIndexCount indices are left, or nothing
+    // can be collapsed anymore
+    void simplify(std::size_t targetIndexCount);
+
+   private:
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        float cost;
+    };
+
+    const std::vector<Vertex>& vertices;
+    // first vertex at the same position. Quadrics, triangle lists and locks
+    // are kept per position.
+    std::vector<unsigned int> positionRemap;
+    // next distinct vertex at the same position, as a circular list
+    std::vector<unsigned int> wedges;
+    std::vector<VertexKind> kinds;
+    std::vector<Quadric> quadrics;
+    // outgoing edges of every vertex and triangles around every position, as
+    // spans into flat arrays
+    std::vector<unsigned int> edgeOffsets;
+    std::vector<unsigned int> edgeTargets;
+    std::vector<unsigned int> triangleOffsets;
+    std::vector<unsigned int> triangleList;
+    // per pass
+    std::vector<Collapse> candidates;
+    std::vector<unsigned int> collapseTargets;
+    std::vector<bool> locked;
+
+    const glm::vec3& position(unsigned int vertex) const {
+        return vertices[vertex].position;
+    }
+
+    void weld(const std::vector<unsigned int>& source);
+    void buildAdjacency();
+    bool hasEdge(unsigned int from, unsigned int to) const;
+    void classify();
+    void computeQuadrics();
+
+    bool canCollapse(unsigned int from, unsigned int to, bool open) const;
+    float cost(unsigned int from, unsigned int to) const;
+    // whether moving from onto to turns any remaining triangle over
+    bool flips(unsigned int from, unsigned int to) const;
+    void gatherCandidates();
+    // performs collapses until about triangleGoal triangles are gone,
+    // returning how many it performed
+    std::size_t collapse(std::size_t triangleGoal);
+    // rewrites the triangles through the collapses, dropping degenerate ones
+    void applyCollapses();
+};
+
+Simplifier::Simplifier(const std::vector<unsigned int>& source,
+                       const std::vector<Vertex>& vertices)
+    : vertices(vertices) {
+    weld(source);
+    buildAdjacency();
+    classify();
+    computeQuadrics();
+}
+
+void Simplifier::simplify(std::size_t targetIndexCount) {
+    while (indices.size() > targetIndexCount) {
+        buildAdjacency();
+        gatherCandidates();
+        if (candidates.empty()) return;
+
+        std::size_t triangleGoal =
+            std::max<std::size_t>((indices.size() - targetIndexCount) / 3, 1);
+        if (collapse(triangleGoal) == 0) return;
+        applyCollapses();
+    }
+}
+
+// Imported meshes often repeat identical vertices for every triangle using
+// them. Those are merged, so the topology (and with it borders and seams) can
+// be told from the indices, and vertices sharing just a position are linked
+// up as wedges of the same point.
+void Simplifier::weld(const std::vector<unsigned int>& source) {
+    std::size_t vertexCount = vertices.size();
+    std::vector<VertexKey> keys(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        keys[v] = makeKey(vertices[v]);
+
+    std::vector<unsigned int> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        return std::memcmp(keys[a].bits, keys[b].bits, sizeof(VertexKey)) < 0;
+    });
+
+    std::vector<unsigned int> attributeRemap(vertexCount);
+    positionRemap.resize(vertexCount);
+    wedges.resize(vertexCount);
+    for (std::size_t i = 0; i < vertexCount; ++i) {
+        unsigned int v = order[i];
+        const std::uint32_t* bits = keys[v].bits;
+        const std::uint32_t* previous = i > 0 ? keys[order[i - 1]].bits : nullptr;
+
+        if (previous &&
+            std::memcmp(bits, previous, sizeof(VertexKey)) == 0) {
+            attributeRemap[v] = attributeRemap[order[i - 1]];
+            positionRemap[v] = positionRemap[order[i - 1]];
+            continue;
+        }
+
+        attributeRemap[v] = v;
+        wedges[v] = v;
+        if (previous && std::memcmp(bits, previous, POSITION_KEY_SIZE) == 0) {
+            // another wedge of the same point: link it in after the first
+            unsigned int first = positionRemap[order[i - 1]];
+            positionRemap[v] = first;
+            wedges[v] = wedges[first];
+            wedges[first] = v;
+        } else {
+            positionRemap[v] = v;
+        }
+    }
+
+    indices.clear();
+    indices.reserve(source.size());
+    for (std::size_t t = 0; t + 2 < source.size(); t += 3) {
+        unsigned int a = attributeRemap[source[t]];
+        unsigned int b = attributeRemap[source[t + 1]];
+        unsigned int c = attributeRemap[source[t + 2]];
+        if (positionRemap[a] == positionRemap[b] ||
+            positionRemap[b] == positionRemap[c] ||
+            positionRemap[a] == positionRemap[c])
+            continue;
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    }
+}
+
+void Simplifier::buildAdjacency() {
+    std::size_t vertexCount = vertices.size();
+    std::size_t triangleCount = indices.size() / 3;
+
+    edgeOffsets.assign(vertexCount + 1, 0);
+    triangleOffsets.assign(vertexCount + 1, 0);
+    for (unsigned int index : indices) {
+        ++edgeOffsets[index + 1];
+        ++triangleOffsets[positionRemap[index] + 1];
+    }
+    for (std::size_t v = 0; v < vertexCount; ++v) {
+        edgeOffsets[v + 1] += edgeOffsets[v];
+        triangleOffsets[v + 1] += triangleOffsets[v];
+    }
+
+    edgeTargets.resize(indices.size());
+    triangleList.resize(indices.size());
+    std::vector<unsigned int> edgeFill(edgeOffsets.begin(),
+                                       edgeOffsets.end() - 1);
+    std::vector<unsigned int> triangleFill(triangleOffsets.begin(),
+                                           triangleOffsets.end() - 1);
+    for (std::size_t t = 0; t < triangleCount; ++t) {
+        for (std::size_t k = 0; k < 3; ++k) {
+            unsigned int from = indices[t * 3 + k];
+            unsigned int to = indices[t * 3 + (k + 1) % 3];
+            edgeTargets[edgeFill[from]++] = to;
+            triangleList[triangleFill[positionRemap[from]]++] =
+                static_cast<unsigned int>(t);
+        }
+    }
+}
+
+bool Simplifier::hasEdge(unsigned int from, unsigned int to) const {
+    for (unsigned int k = edgeOffsets[from]; k < edgeOffsets[from + 1]; ++k)
+        if (edgeTargets[k] == to) return true;
+    return false;
+}
+
+// An edge without a twin running the other way is open: either on a border
+// of the surface, or on a seam, where the other side uses different wedges.
+// A vertex with exactly one open edge in and one out lies on a simple border
+// or, if its single other wedge's open edges lead to the same points the
+// other way round, on a simple seam.
+void Simplifier::classify() {
+    std::size_t vertexCount = vertices.size();
+    // the neighbour across the open edge, or the vertex itself if there is
+    // more than one
+    std::vector<unsigned int> openOut(vertexCount, NO_VERTEX);
+    std::vector<unsigned int> openIn(vertexCount, NO_VERTEX);
+    for (std::size_t t = 0; t < indices.size(); t += 3) {
+        for (std::size_t k = 0; k < 3; ++k) {
+            unsigned int from = indices[t + k];
+            unsigned int to = indices[t + (k + 1) % 3];
+            if (hasEdge(to, from)) continue;
+            openOut[from] = openOut[from] == NO_VERTEX ? to : from;
+            openIn[to] = openIn[to] == NO_VERTEX ? from : to;
+        }
+    }
+
+    auto single = [&](const std::vector<unsigned int>& open, unsigned int v) {
+        return open[v] != NO_VERTEX && open[v] != v;
+    };
+
+    kinds.assign(vertexCount, VertexKind::Locked);
+    for (unsigned int v = 0; v < vertexCount; ++v) {
+        unsigned int wedge = wedges[v];
+        if (wedge == v) {
+            if (openOut[v] == NO_VERTEX && openIn[v] == NO_VERTEX)
+                kinds[v] = VertexKind::Manifold;
+            else if (single(openOut, v) && single(openIn, v))
+                kinds[v] = VertexKind::Border;
+        } else if (wedges[wedge] == v) {
+            if (single(openOut, v) && single(openIn, v) &&
+                single(openOut, wedge) && single(openIn, wedge) &&
+                positionRemap[openIn[v]] == positionRemap[openOut[wedge]] &&
+                positionRemap[openOut[v]] == positionRemap[openIn[wedge]])
+                kinds[v] = VertexKind::Seam;
+        }
+    }
+}
+
+void Simplifier::computeQuadrics() {
+    quadrics.assign(vertices.size(), Quadric{});
+    for (std::size_t t = 0; t < indices.size(); t += 3) {
+        const unsigned int* triangle = &indices[t];
+        const glm::vec3& p0 = position(triangle[0]);
+        glm::vec3 normal =
+            glm::cross(position(triangle[1]) - p0, position(triangle[2]) - p0);
+        float length = glm::length(normal);
+        if (length == 0.0f) continue;
+        normal /= length;
+
+        // the surface, weighted by area
+        for (std::size_t k = 0; k < 3; ++k)
+            quadrics[positionRemap[triangle[k]]].addPlane(normal, p0,
+                                                          length * 0.5);
+
+        for (std::size_t k = 0; k < 3; ++k) {
+            unsigned int from = triangle[k];
+            unsigned int to = triangle[(k + 1) % 3];
+            if (hasEdge(to, from)) continue;
+
+            glm::vec3 edge = position(to) - position(from);
+            float edgeLength = glm::length(edge);
+            if (edgeLength == 0.0f) continue;
+            glm::vec3 side = glm::cross(edge, normal) / edgeLength;
+            double weight = static_cast<double>(edgeLength) * edgeLength *
+                            BORDER_WEIGHT;
+            quadrics[positionRemap[from]].addPlane(side, position(from),
+                                                   weight);
+            quadrics[positionRemap[to]].addPlane(side, position(from), weight);
+        }
+    }
+}
+
+bool Simplifier::canCollapse(unsigned int from, unsigned int to,
+                             bool open) const {
+    if (positionRemap[from] == positionRemap[to]) return false;
+
+    switch (kinds[from]) {
+        case VertexKind::Manifold:
+            return true;
+        case VertexKind::Border:
+            return open && kinds[to] == VertexKind::Border;
+        case VertexKind::Seam:
+            // the other side has to run along the same edge
+            return open && kinds[to] == VertexKind::Seam &&
+                   (hasEdge(wedges[from], wedges[to]) ||
+                    hasEdge(wedges[to], wedges[from]));
+        case VertexKind::Locked:
+            return false;
+    }
+    return false;
+}
+
+float Simplifier::cost(unsigned int from, unsigned int to) const {
+    Quadric merged = quadrics[positionRemap[from]];
+    merged.add(quadrics[positionRemap[to]]);
+    return static_cast<float>(std::sqrt(merged.error(position(to))));
+}
+
+bool Simplifier::flips(unsigned int from, unsigned int to) const {
+    unsigned int movedRoot = positionRemap[from];
+    unsigned int targetRoot = positionRemap[to];
+    const glm::vec3& target = position(to);
+
+    for (unsigned int k = triangleOffsets[movedRoot];
+         k < triangleOffsets[movedRoot + 1]; ++k) {
+        const unsigned int* triangle = &indices[triangleList[k] * 3];
+        glm::vec3 before[3];
+        glm::vec3 after[3];
+        bool collapses = false;
+        for (std::size_t c = 0; c < 3; ++c) {
+            unsigned int root = positionRemap[triangle[c]];
+            collapses = collapses || root == targetRoot;
+            before[c] = position(triangle[c]);
+            after[c] = root == movedRoot ? target : before[c];
+        }
+        // triangles along the edge disappear
+        if (collapses) continue;
+
+        glm::vec3 normalBefore =
+            glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 normalAfter =
+            glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(normalBefore, normalAfter) <=
+            MIN_NORMAL_COSINE * glm::length(normalBefore) *
+                glm::length(normalAfter))
+            return true;
+    }
+    return false;
+}
+
+void Simplifier::gatherCandidates() {
+    candidates.clear();
+    for (std::size_t t = 0; t < indices.size(); t += 3) {
+        for (std::size_t k = 0; k < 3; ++k) {
+            unsigned int a = indices[t + k];
+            unsigned int b = indices[t + (k + 1) % 3];
+            bool open = !hasEdge(b, a);
+            // interior edges turn up once from either side
+            if (!open && a > b) continue;
+
+            // the cheaper direction
+            Collapse best{NO_VERTEX, NO_VERTEX, 0.0f};
+            if (canCollapse(a, b, open)) best = {a, b, cost(a, b)};
+            if (canCollapse(b, a, open)) {
+                float reverse = cost(b, a);
+                if (best.from == NO_VERTEX || reverse < best.cost)
+                    best = {b, a, reverse};
+            }
+            if (best.from != NO_VERTEX) candidates.push_back(best);
+        }
+    }
+}
+
+std::size_t Simplifier::collapse(std::size_t triangleGoal) {
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Collapse& a, const Collapse& b) {
+                  return a.cost < b.cost;
+              });
+
+    collapseTargets.resize(vertices.size());
+    std::iota(collapseTargets.begin(), collapseTargets.end(), 0u);
+    locked.assign(vertices.size(), false);
+
+    std::size_t removed = 0;
+    std::size_t performed = 0;
+    for (const Collapse& candidate : candidates) {
+        if (removed >= triangleGoal) break;
+        unsigned int movedRoot = positionRemap[candidate.from];
+        unsigned int targetRoot = positionRemap[candidate.to];
+        if (locked[movedRoot] || locked[targetRoot]) continue;
+        if (flips(candidate.from, candidate.to)) continue;
+
+        VertexKind kind = kinds[candidate.from];
+        collapseTargets[candidate.from] = candidate.to;
+        if (kind == VertexKind::Seam)
+            collapseTargets[wedges[candidate.from]] = wedges[candidate.to];
+        quadrics[targetRoot].add(quadrics[movedRoot]);
+        error = std::max(error, candidate.cost);
+
+        locked[targetRoot] = true;
+        for (unsigned int k = triangleOffsets[movedRoot];
+             k < triangleOffsets[movedRoot + 1]; ++k)
+            for (std::size_t c = 0; c < 3; ++c)
+                locked[positionRemap[indices[triangleList[k] * 3 + c]]] = true;
+
+        // an interior edge takes a triangle on either side with it, a border
+        // edge just one; a seam edge one on each side of the seam
+        removed += kind == VertexKind::Border ? 1 : 2;
+        ++performed;
+    }
+    return performed;
+}
+
+void Simplifier::applyCollapses() {
+    std::size_t kept = 0;
+    for (std::size_t t = 0; t < indices.size(); t += 3) {
+        unsigned int a = collapseTargets[indices[t]];
+        unsigned int b = collapseTargets[indices[t + 1]];
+        unsigned int c = collapseTargets[indices[t + 2]];
+        if (positionRemap[a] == positionRemap[b] ||
+            positionRemap[b] == positionRemap[c] ||
+            positionRemap[a] == positionRemap[c])
+            continue;
+        indices[kept++] = a;
+        indices[kept++] = b;
+        indices[kept++] = c;
+    }
+    indices.resize(kept);
+}
+
+}  // namespace
+
+std::vector<MeshLod> generateLods(std::vector<unsigned int>& indices,
+                                  const std::vector<Vertex>& vertices,
+                                  unsigned int levels) {
+    std::vector<MeshLod> lods{MeshLod{0, indices.size(), 0.0f}};
+    if (indices.size() / 3 < LOD_MIN_TRIANGLES * 2) return lods;
+
+    // every level continues from the previous one, so the error only grows
+    Simplifier simplifier(indices, vertices);
+    std::size_t previousCount = indices.size();
+    for (unsigned int level = 1; level <= levels; ++level) {
+        std::size_t targetCount = previousCount / 6 * 3;
+        if (targetCount / 3 < LOD_MIN_TRIANGLES) break;
+
+        simplifier.simplify(targetCount);
+        std::vector<unsigned int> levelIndices = simplifier.indices;
+        if (static_cast<float>(levelIndices.size()) >
+            MAX_LEVEL_RATIO * static_cast<float>(previousCount))
+            break;
+
+        optimizeVertexCache(levelIndices, vertices.size());
+        lods.push_back(MeshLod{indices.size(), levelIndices.size(),
+                               std::max(simplifier.error, lods.back().error)});
+        indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+        previousCount = levelIndices.size();
+    }
+    return lods;
+}
+
+}  // namespace personal::renderer::utility
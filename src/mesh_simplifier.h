@@ -0,0 +1,36 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.h"
+
+namespace personal::renderer::utility {
+
+// Simplified levels generated per mesh on top of the full detail one
+const unsigned int LOD_LEVELS = 3;
+// levels aren't simplified below this many triangles
+const std::size_t LOD_MIN_TRIANGLES = 64;
+
+// Generates up to levels simplified versions of a triangle list, each with
+// about half the triangles of the previous, and appends their indices after
+// the full detail ones. Returns every level, starting with the full detail
+// one, as its range of the index list and its error: how far, in object
+// space units, it deviates from the full detail mesh.
+//
+// Edges are collapsed cheapest first by their quadric error (Garland &
+// Heckbert, "Surface Simplification Using Quadric Error Metrics"). A collapse
+// merges a vertex into a neighbour without moving or creating any, so every
+// level indexes into the same vertices. Vertices that share a position but
+// differ in normal or texture coordinates form seams; seams and open borders
+// are only collapsed along themselves, so they keep their shape on both
+// sides, and collapses that would flip a triangle are skipped. Levels are
+// optimized for the vertex cache.
+std::vector<MeshLod> generateLods(std::vector<unsigned int>& indices,
+                                  const std::vector<Vertex>& vertices,
+                                  unsigned int levels = LOD_LEVELS);
+
+}  // namespace personal::renderer::utility
+
+#endif  // MESH_SIMPLIFIER_H
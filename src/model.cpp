@@ -1,9 +1,31 @@
 #include "model.h"
 
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "dds.h"
+#include "lod_selector.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "obj_loader.h"
+#include "render_queue.h"
 #include "stb_image.h"
+#include "texture.h"
+#include "thread_pool.h"
 
 namespace personal::renderer::utility {
 
+// assimp post-processing applied on import. These are part of the mesh cache
+// key, so changing them invalidates every cached model.
+const unsigned int IMPORT_FLAGS = aiProcess_Triangulate |
+                                  aiProcess_GenSmoothNormals |
+                                  aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
 RawModel::RawModel(std::vector<float>& positions, std::vector<float>& texCoords)
     : numTriangles(positions.size()) {
     // Generate Vertex Array Object
@@ -122,116 +144,200 @@ void RawModel::draw(const Shader&) const {
     glBindVertexArray(0);
 }
 
-AssimpModel::AssimpModel(const std::string& path, bool gamma)
-    : gammaCorrection(gamma) {
-    loadModel(path);
+namespace {
+
+// remembers a texture path the model uses, once
+void addTexturePath(ImportedModel& model, const std::string& path) {
+    if (std::find(model.texturePaths.begin(), model.texturePaths.end(),
+                  path) == model.texturePaths.end())
+        model.texturePaths.push_back(path);
 }
 
-// draws the model, and thus all its meshes
-void AssimpModel::draw(const Shader& shader) const {
-    for (unsigned int i = 0; i < meshes.size(); i++) meshes[i].draw(shader);
-}
-
-// loads a model with supported ASSIMP extensions from file and stores the
-// resulting meshes in the meshes vector.
-void AssimpModel::loadModel(const std::string& path) {
-    // read file via ASSIMP
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(
-        path, aiProcess_Triangulate | aiProcess_GenSmoothNormals |
-                  aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-    // check for errors
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
-        !scene->mRootNode)  // if is Not Zero
-    {
-        std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << '\n';
+// collects the textures of one material slot. They're decoded for the whole
+// model at once later on.
+void collectMaterialTextures(aiMaterial* material, aiTextureType type,
+                             const std::string& typeName, ImportedModel& model,
+                             std::vector<Texture>& textures) {
+    for (unsigned int i = 0; i < material->GetTextureCount(type); ++i) {
+        aiString str;
+        material->GetTexture(type, i, &str);
+        textures.push_back(Texture{0, typeName, str.C_Str()});
+        addTexturePath(model, str.C_Str());
+    }
+}
+
+// computes the bounds and converts the vertices and indices into the layout
+// they're uploaded in
+void finishMesh(ImportedMesh& mesh, VertexFormat format) {
+    mesh.vertexCount = mesh.vertices.size();
+    mesh.indexCount = mesh.indices.size();
+    mesh.bounds = computeBounds(mesh.vertices.data(), mesh.vertexCount);
+    mesh.sphere = computeBoundingSphere(mesh.vertices.data(),
+                                        mesh.vertexCount, mesh.bounds);
+
+    // small meshes upload half-size indices
+    mesh.indexType = indexTypeFor(mesh.vertexCount);
+    if (mesh.indexType == GL_UNSIGNED_SHORT) {
+        mesh.shortIndices = narrowIndices(mesh.indices);
+        mesh.indexData = mesh.shortIndices.data();
+    } else {
+        mesh.indexData = mesh.indices.data();
+    }
+
+    if (format == VertexFormat::Packed) {
+        mesh.packedVertices = packVertices(mesh.vertices.data(),
+                                           mesh.vertexCount, mesh.quantization);
+        mesh.vertexData = mesh.packedVertices.data();
+    } else {
+        mesh.vertexData = mesh.vertices.data();
+    }
+}
+
+// vertices or faces converted per task when a mesh is split across the pool
+const std::size_t CONVERSION_CHUNK = 64 * 1024;
+
+// runs body over [0, count) in chunks, spread across the shared pool when
+// there is more than one
+void forEachChunk(std::size_t count,
+                  const std::function<void(std::size_t, std::size_t)>& body) {
+    std::size_t chunks = (count + CONVERSION_CHUNK - 1) / CONVERSION_CHUNK;
+    if (chunks <= 1) {
+        body(0, count);
         return;
     }
-    // retrieve the directory path of the filepath
-    directory = path.substr(0, path.find_last_of('/'));
+    ThreadPool::shared().parallelFor(chunks, [&](std::size_t chunk) {
+        std::size_t begin = chunk * CONVERSION_CHUNK;
+        body(begin, std::min(count, begin + CONVERSION_CHUNK));
+    });
+}
+
+void assign(glm::vec3& target, const aiVector3D& source) {
+    target.x = source.x;
+    target.y = source.y;
+    target.z = source.z;
+}
+
+void assign(glm::vec2& target, const aiVector3D& source) {
+    target.x = source.x;
+    target.y = source.y;
+}
+
+// copies one attribute stream into its member of every vertex in
+// [begin, end). Just strided moves, which the compiler vectorizes.
+template <typename T>
+void copyAttribute(const aiVector3D* source, T Vertex::*member,
+                   Vertex* vertices, std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i)
+        assign(vertices[i].*member, source[i]);
+}
+
+// converts vertices [begin, end) of an assimp mesh into already zeroed
+// vertices. The presence checks are done once per attribute rather than per
+// vertex; missing attributes stay zero.
+void convertVertices(const aiMesh* mesh, Vertex* vertices, std::size_t begin,
+                     std::size_t end) {
+    copyAttribute(mesh->mVertices, &Vertex::position, vertices, begin, end);
+    if (mesh->HasNormals())
+        copyAttribute(mesh->mNormals, &Vertex::normal, vertices, begin, end);
+    // only the first of the up to 8 texture coordinate sets is used
+    if (mesh->HasTextureCoords(0))
+        copyAttribute(mesh->mTextureCoords[0], &Vertex::texCoords, vertices,
+                      begin, end);
+    if (mesh->HasTangentsAndBitangents()) {
+        copyAttribute(mesh->mTangents, &Vertex::tangent, vertices, begin, end);
+        copyAttribute(mesh->mBitangents, &Vertex::bitangent, vertices, begin,
+                      end);
+    }
+}
 
-    // process ASSIMP's root node recursively
-    processNode(scene->mRootNode, scene);
+// copies every face's indices. Triangulated meshes have 3 per face, so their
+// faces can be converted in chunks; meshes that kept points or lines are
+// walked once to count them first.
+void convertIndices(const aiMesh* mesh, std::vector<unsigned int>& indices) {
+    std::size_t faceCount = mesh->mNumFaces;
+    if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+        indices.resize(faceCount * 3);
+        unsigned int* target = indices.data();
+        forEachChunk(faceCount, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t i = begin; i < end; ++i)
+                std::memcpy(target + i * 3, mesh->mFaces[i].mIndices,
+                            3 * sizeof(unsigned int));
+        });
+        return;
+    }
+
+    std::size_t indexCount = 0;
+    for (std::size_t i = 0; i < faceCount; ++i)
+        indexCount += mesh->mFaces[i].mNumIndices;
+    indices.resize(indexCount);
+    unsigned int* target = indices.data();
+    for (std::size_t i = 0; i < faceCount; ++i) {
+        const aiFace& face = mesh->mFaces[i];
+        target = std::copy_n(face.mIndices, face.mNumIndices, target);
+    }
 }
 
+// optimizes an imported mesh and generates its levels of detail as the
+// model's import options ask, then converts it for upload
+void postProcessMesh(ImportedMesh& imported, const ImportedModel& model) {
+    std::vector<Vertex>& vertices = imported.vertices;
+    std::vector<unsigned int>& indices = imported.indices;
+
+    const ImportOptions& options = model.options;
+    if (options.optimizeIndices) {
+        imported.acmrBefore = averageCacheMissRatio(indices, vertices.size());
+        optimizeVertexCache(indices, vertices.size());
+        if (options.optimizeOverdraw) optimizeOverdraw(indices, vertices);
+        imported.acmrAfter = averageCacheMissRatio(indices, vertices.size());
+    }
+    // the simplified levels go after the full detail indices and use the
+    // same vertices
+    if (options.generateLods) {
+        imported.lods = generateLods(indices, vertices);
+    }
+    if (options.optimizeIndices) optimizeVertexFetch(vertices, indices);
+
+    finishMesh(imported, options.vertexFormat);
+}
+
+ImportedMesh processMesh(aiMesh* mesh, const aiScene* scene,
+                         ImportedModel& model);
+
 // processes a node in a recursive fashion. Processes each individual mesh
 // located at the node and repeats this process on its children nodes (if any).
-void AssimpModel::processNode(aiNode* node, const aiScene* scene) {
+void processNode(aiNode* node, const aiScene* scene, ImportedModel& model) {
     // process each mesh located at the current node
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
         // the node object only contains indices to index the actual objects in
         // the scene. the scene contains all the data, node is just to keep
         // stuff organized (like relations between nodes).
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(processMesh(mesh, scene));
+        model.meshes.push_back(processMesh(mesh, scene, model));
     }
     // after we've processed all of the meshes (if any) we then recursively
     // process each of the children nodes
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, model);
     }
 }
 
-Mesh AssimpModel::processMesh(aiMesh* mesh, const aiScene* scene) {
+ImportedMesh processMesh(aiMesh* mesh, const aiScene* scene,
+                         ImportedModel& model) {
     // data to fill
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture> textures;
-
-    // walk through each of the mesh's vertices
-    for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
-        glm::vec3 vector;  // we declare a placeholder vector since assimp uses
-                           // its own vector class that doesn't directly convert
-                           // to glm's vec3 class so we transfer the data to
-                           // this placeholder glm::vec3 first.
-        // positions
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.position = vector;
-        // normals
-        if (mesh->HasNormals()) {
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.normal = vector;
-        }
-        // texture coordinates
-        if (mesh->mTextureCoords[0])  // does the mesh contain texture
-                                      // coordinates?
-        {
-            glm::vec2 vec;
-            // a vertex can contain up to 8 different texture coordinates. We
-            // thus make the assumption that we won't use models where a vertex
-            // can have multiple texture coordinates so we always take the first
-            // set (0).
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.texCoords = vec;
-            // tangent
-            vector.x = mesh->mTangents[i].x;
-            vector.y = mesh->mTangents[i].y;
-            vector.z = mesh->mTangents[i].z;
-            vertex.tangent = vector;
-            // bitangent
-            vector.x = mesh->mBitangents[i].x;
-            vector.y = mesh->mBitangents[i].y;
-            vector.z = mesh->mBitangents[i].z;
-            vertex.bitangent = vector;
-        } else
-            vertex.texCoords = glm::vec2(0.0f, 0.0f);
-
-        vertices.push_back(vertex);
-    }
-    // now wak through each of the mesh's faces (a face is a mesh its triangle)
-    // and retrieve the corresponding vertex indices.
-    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
-        // retrieve all indices of the face and store them in the indices vector
-        for (unsigned int j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
-    }
+    ImportedMesh imported;
+    std::vector<Vertex>& vertices = imported.vertices;
+    std::vector<unsigned int>& indices = imported.indices;
+    std::vector<Texture>& textures = imported.textures;
+
+    // every attribute is copied in its own pass over a chunk, see
+    // convertVertices(). Large meshes are converted on the pool.
+    std::size_t vertexCount = mesh->mNumVertices;
+    vertices.resize(vertexCount);
+    forEachChunk(vertexCount, [&](std::size_t begin, std::size_t end) {
+        convertVertices(mesh, vertices.data(), begin, end);
+    });
+    convertIndices(mesh, indices);
+
     // process materials
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
     // we assume a convention for sampler names in the shaders. Each diffuse
@@ -242,100 +348,332 @@ Mesh AssimpModel::processMesh(aiMesh* mesh, const aiScene* scene) {
     // normal: texture_normalN
 
     // 1. diffuse maps
-    std::vector<Texture> diffuseMaps = loadMaterialTextures(
-        material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+    collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse",
+                            model, textures);
     // 2. specular maps
-    std::vector<Texture> specularMaps = loadMaterialTextures(
-        material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    collectMaterialTextures(material, aiTextureType_SPECULAR,
+                            "texture_specular", model, textures);
     // 3. normal maps
-    std::vector<Texture> normalMaps =
-        loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+    collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal",
+                            model, textures);
     // 4. height maps
-    std::vector<Texture> heightMaps =
-        loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+    collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height",
+                            model, textures);
 
-    // return a mesh object created from the extracted mesh data
-    return Mesh(vertices, indices, textures);
+    postProcessMesh(imported, model);
+    return imported;
 }
 
-// checks all material textures of a given type and loads the textures if
-// they're not loaded yet. the required info is returned as a Texture struct.
-std::vector<Texture> AssimpModel::loadMaterialTextures(aiMaterial* mat,
-                                                       aiTextureType type,
-                                                       std::string typeName) {
-    std::vector<Texture> textures;
-    for (unsigned int i = 0; i < mat->GetTextureCount(type); ++i) {
-        aiString str;
-        mat->GetTexture(type, i, &str);
-        // check if texture was loaded before and if so, continue to next
-        // iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); ++j) {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-                textures.push_back(textures_loaded[j]);
-                skip =
-                    true;  // a texture with the same filepath has already been
-                           // loaded, continue to next one. (optimization)
-                break;
+// prints the model's average cache miss ratio before and after the index
+// optimization, weighted by triangles, as one line. Models import on the
+// pool side by side, so the line is built first and written at once.
+void reportCacheMissRatio(const ImportedModel& model) {
+    double before = 0.0;
+    double after = 0.0;
+    std::size_t triangles = 0;
+    for (const ImportedMesh& mesh : model.meshes) {
+        // level 0 is the full detail part of the indices
+        std::size_t meshTriangles =
+            (mesh.lods.empty() ? mesh.indexCount : mesh.lods[0].indexCount) /
+            3;
+        before += mesh.acmrBefore * static_cast<double>(meshTriangles);
+        after += mesh.acmrAfter * static_cast<double>(meshTriangles);
+        triangles += meshTriangles;
+    }
+    if (triangles == 0) return;
+
+    std::ostringstream line;
+    line << "MESH_OPTIMIZER:: " << model.directory << ": ACMR "
+         << before / static_cast<double>(triangles) << " -> "
+         << after / static_cast<double>(triangles) << " ("
+         << model.meshes.size() << " meshes, " << triangles
+         << " triangles)\n";
+    std::cout << line.str() << std::flush;
+}
+
+// takes over the meshes the native OBJ loader read, with their material's
+// maps in the same slots processMesh() fills from assimp's materials
+void processObj(ObjModel& obj, ImportedModel& model) {
+    model.meshes.reserve(obj.meshes.size());
+    for (ObjMesh& mesh : obj.meshes) {
+        ImportedMesh imported;
+        imported.vertices = std::move(mesh.vertices);
+        imported.indices = std::move(mesh.indices);
+        if (mesh.material >= 0) {
+            const ObjMaterial& material = obj.materials[mesh.material];
+            const std::pair<const std::string*, const char*> maps[] = {
+                {&material.diffuse, "texture_diffuse"},
+                {&material.specular, "texture_specular"},
+                {&material.bump, "texture_normal"},
+                {&material.ambient, "texture_height"}};
+            for (const auto& [path, typeName] : maps) {
+                if (path->empty()) continue;
+                imported.textures.push_back(Texture{0, typeName, *path});
+                addTexturePath(model, *path);
+            }
+        }
+        postProcessMesh(imported, model);
+        model.meshes.push_back(std::move(imported));
+    }
+}
+
+
+}  // namespace
+
+std::size_t ImportedMesh::uploadSize(VertexFormat format) const {
+    return vertexCount * vertexSize(format) + indexCount * indexSize(indexType);
+}
+
+void ImportedMesh::release() {
+    vertexData = nullptr;
+    indexData = nullptr;
+    vertices = {};
+    packedVertices = {};
+    indices = {};
+    shortIndices = {};
+}
+
+ImportedModel importModel(const std::string& path,
+                          const ImportOptions& options) {
+    ImportedModel model;
+    model.options = options;
+    // retrieve the directory path of the filepath
+    model.directory = path.substr(0, path.find_last_of('/'));
+
+    // warm start: if the model has been imported before with the same flags,
+    // skip assimp entirely and upload the processed meshes straight from the
+    // mapped cache file
+    auto cache = std::make_shared<MeshCache>(path, IMPORT_FLAGS, options);
+    if (cache->load()) {
+        model.meshes.reserve(cache->meshes().size());
+        for (const CachedMesh& cached : cache->meshes()) {
+            ImportedMesh mesh;
+            mesh.vertexData = cached.vertices;
+            mesh.vertexCount = cached.vertexCount;
+            mesh.indexType = cached.indexType;
+            mesh.indexData = cached.indices;
+            mesh.indexCount = cached.indexCount;
+            mesh.quantization = cached.quantization;
+            mesh.bounds = cached.bounds;
+            mesh.sphere = cached.sphere;
+            mesh.lods = cached.lods;
+            for (const CachedTexture& texture : cached.textures) {
+                mesh.textures.push_back(Texture{0, texture.type, texture.path});
+                addTexturePath(model, texture.path);
             }
+            model.meshes.push_back(std::move(mesh));
         }
-        if (!skip) {  // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = textureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(
-                texture);  // store it as texture loaded for entire model, to
-                           // ensure we won't unnecessary load duplicate
-                           // textures.
+        model.cache = cache;
+    } else {
+        // OBJ files go through the native loader, unless they use something
+        // it doesn't handle
+        ObjModel obj;
+        if (isObjFile(path) && loadObj(path, obj)) {
+            processObj(obj, model);
+        } else {
+            // read file via ASSIMP
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
+            // check for errors
+            if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+                !scene->mRootNode)  // if is Not Zero
+            {
+                std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString()
+                          << '\n';
+                return model;
+            }
+
+            // process ASSIMP's root node recursively
+            processNode(scene->mRootNode, scene, model);
         }
+
+        // store the processed meshes so the next start can skip the import
+        cache->write(model.meshes);
+        if (options.optimizeIndices) reportCacheMissRatio(model);
+    }
+
+    // decode every texture the model's meshes reference, in parallel, unless
+    // another model or path already loaded it
+    TextureCache& textureCache = TextureCache::shared();
+    const std::vector<std::string>& paths = model.texturePaths;
+    model.textures.resize(paths.size());
+    ThreadPool::shared().parallelFor(paths.size(), [&](std::size_t i) {
+        model.textures[i] =
+            textureCache.prepare(model.directory + '/' + paths[i]);
+    });
+
+    model.valid = true;
+    return model;
+}
+
+AssimpModel::AssimpModel(const std::string& path, bool gamma,
+                         ImportOptions options)
+    : AssimpModel(importModel(path, options), gamma) {
+    upload(std::numeric_limits<std::size_t>::max());
+}
+
+AssimpModel::AssimpModel(ImportedModel imported, bool gamma)
+    : directory(imported.directory),
+      gammaCorrection(gamma),
+      options(imported.options),
+      pending(std::move(imported)) {
+    textures_loaded.reserve(pending.texturePaths.size());
+    meshes.reserve(pending.meshes.size());
+}
+
+std::size_t AssimpModel::upload(std::size_t byteBudget,
+                                TextureUploader* uploader) {
+    std::size_t uploaded = 0;
+    if (uploadComplete) return uploaded;
+
+    do {
+        // textures go first, since the meshes reference them
+        if (texturesUploaded < pending.texturePaths.size()) {
+            TextureRequest& request = pending.textures[texturesUploaded];
+            const DecodedImage& image = request.image;
+            if (!request.compressed.empty())
+                uploaded += request.compressed.totalSize();
+            else if (image.pixels)
+                uploaded += static_cast<std::size_t>(image.width) *
+                            static_cast<std::size_t>(image.height) *
+                            static_cast<std::size_t>(image.components);
+
+            textures_loaded[pending.texturePaths[texturesUploaded]] =
+                TextureCache::shared().finish(request, uploader);
+            ++texturesUploaded;
+        } else if (meshesUploaded < pending.meshes.size()) {
+            ImportedMesh& mesh = pending.meshes[meshesUploaded];
+            std::vector<Texture> textures;
+            for (const Texture& texture : mesh.textures)
+                textures.push_back(
+                    findOrLoadTexture(texture.path.c_str(), texture.type));
+            meshes.emplace_back(options.vertexFormat, mesh.vertexData,
+                                mesh.vertexCount, mesh.indexType,
+                                mesh.indexData, mesh.indexCount, textures,
+                                mesh.bounds, mesh.sphere, mesh.quantization,
+                                options.arena, std::move(mesh.lods));
+
+            uploaded += mesh.uploadSize(options.vertexFormat);
+            mesh.release();
+            ++meshesUploaded;
+        }
+
+        if (texturesUploaded == pending.texturePaths.size() &&
+            meshesUploaded == pending.meshes.size()) {
+            gatherBounds();
+            // drops the CPU copies and unmaps the cache file
+            pending = ImportedModel{};
+            uploadComplete = true;
+        }
+    } while (!uploadComplete && uploaded < byteBudget);
+
+    return uploaded;
+}
+
+bool AssimpModel::resident() const { return uploadComplete; }
+
+// draws the model, and thus all its meshes
+void AssimpModel::draw(const Shader& shader) const {
+    for (unsigned int i = 0; i < meshes.size(); i++)
+        batchDraw(shader, meshes[i]);
+    flushBatch(shader);
+}
+
+void AssimpModel::draw(const Shader& shader, const Frustum& frustum,
+                       CullingStats& stats) const {
+    visibleMeshes.clear();
+    cullBounds(frustum, meshBounds, visibleMeshes, stats);
+    for (unsigned int i : visibleMeshes) batchDraw(shader, meshes[i]);
+    flushBatch(shader);
+}
+
+void AssimpModel::submit(RenderQueue& queue, const Shader& shader,
+                         const glm::mat4& transform, const Frustum& frustum,
+                         CullingStats& stats, const LodSelector* lod) const {
+    bool selected = selectVisible(transform, frustum, stats, lod);
+    for (unsigned int i : visibleMeshes)
+        queue.submit(meshes[i], shader, transform, RenderPass::Opaque, 0,
+                     selected ? meshLevels[i] : 0);
+}
+
+void AssimpModel::record(DrawList& list, const Shader& shader,
+                         const glm::mat4& transform, const Frustum& frustum,
+                         CullingStats& stats, const LodSelector* lod) const {
+    bool selected = selectVisible(transform, frustum, stats, lod);
+    for (unsigned int i : visibleMeshes)
+        list.add(meshes[i], shader, transform, RenderPass::Opaque, 0,
+                 selected ? meshLevels[i] : 0);
+}
+
+bool AssimpModel::selectVisible(const glm::mat4& transform,
+                                const Frustum& frustum, CullingStats& stats,
+                                const LodSelector* lod) const {
+    visibleMeshes.clear();
+    cullBounds(frustum, meshBounds, visibleMeshes, stats);
+    if (!lod || meshLevels.size() != meshes.size()) return false;
+
+    float scale = maxScale(transform);
+    for (unsigned int i : visibleMeshes) {
+        const Mesh& mesh = meshes[i];
+        glm::vec3 center =
+            glm::vec3(transform * glm::vec4(mesh.sphere.center, 1.0f));
+        float distance = lod->distanceTo(center, mesh.sphere.radius * scale);
+        meshLevels[i] = lod->select(mesh.lods, scale, distance, meshLevels[i]);
     }
-    return textures;
+    return true;
+}
+
+void AssimpModel::batchDraw(const Shader& shader, const Mesh& mesh) const {
+    if (!batch.empty() && !batch.front()->canBatchWith(mesh))
+        flushBatch(shader);
+    batch.push_back(&mesh);
+}
+
+void AssimpModel::flushBatch(const Shader& shader) const {
+    Mesh::drawMulti(shader, batch);
+    batch.clear();
+}
+
+// gathers the bounds of the loaded meshes for culling
+void AssimpModel::gatherBounds() {
+    meshBounds.clear();
+    meshBounds.reserve(meshes.size());
+    meshLevels.assign(meshes.size(), 0);
+    for (std::size_t i = 0; i < meshes.size(); ++i) {
+        meshBounds.push(meshes[i].bounds);
+        bounds = i == 0 ? meshes[i].bounds
+                        : mergeBounds(bounds, meshes[i].bounds);
+    }
+}
+
+// returns the texture at the given path (relative to the model directory),
+// loading it through the texture cache if the model doesn't hold it yet
+Texture AssimpModel::findOrLoadTexture(const char* path,
+                                       const std::string& typeName) {
+    TextureHandle& handle = textures_loaded[path];
+    if (!handle) handle = TextureCache::shared().load(directory + '/' + path);
+
+    // the slot it's used in is up to this material
+    return Texture{handle->id, typeName, path};
 }
 
 unsigned int textureFromFile(const char* path, const std::string& directory,
-                             [[maybe_unused]] bool gamma) {
+                             bool gamma) {
     std::string filename = std::string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data =
-        stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format{};
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                     GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                        GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+    // cooked textures come with their mips and need no decoding
+    CompressedImage compressed;
+    if (readCookedTexture(filename, compressed)) {
+        unsigned int textureID = uploadCompressedTexture(compressed, gamma);
+        if (textureID) return textureID;
     }
 
-    return textureID;
+    DecodedImage image = decodeImage(filename);
+    if (!image.pixels)
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+
+    return uploadTexture(image);
 }
 
 };  // namespace personal::renderer::utility
\ No newline at end of file
@@ -6,19 +6,111 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "stb_image.h"
 
 #include "mesh.h"
+#include "texture.h"
+#include "texture_cache.h"
 /* clang-format on  */
 
 namespace personal::renderer::utility {
 
+class LodSelector;
+class MeshCache;
+class RenderQueue;
+struct DrawList;
+
 unsigned int textureFromFile(const char* path, const std::string& directory,
                              bool gamma = false);
 
+// Settings that control how AssimpModel processes a model on import
+struct ImportOptions {
+    // Packed quantizes static meshes to a quarter of the vertex size, but
+    // needs a shader that decodes it (shaders/packed.vert)
+    VertexFormat vertexFormat{VertexFormat::Standard};
+    // reorders each mesh's triangles for the post-transform vertex cache and
+    // its vertices for fetch locality, logging the ACMR before and after
+    bool optimizeIndices{false};
+    // with optimizeIndices, also reorders triangle clusters to reduce
+    // overdraw at a small cost in cache efficiency
+    bool optimizeOverdraw{false};
+    // appends simplified levels of detail to each mesh's index buffer, see
+    // generateLods()
+    bool generateLods{false};
+    // suballocate the meshes from this arena instead of giving each its own
+    // VAO and buffers, so consecutive meshes can be multi-drawn. Not for
+    // models drawn through InstancedModel, which needs a VAO per mesh.
+    GeometryArena* arena{nullptr};
+};
+
+// A mesh converted to its GPU layout on the CPU and waiting to be uploaded.
+// The data pointers point into the mesh's own vectors or, for meshes read
+// from the mesh cache, into the mapped cache file. Move-only, so they never
+// dangle.
+struct ImportedMesh {
+    const void* vertexData{nullptr};
+    std::size_t vertexCount{0};
+    GLenum indexType{GL_UNSIGNED_INT};
+    const void* indexData{nullptr};
+    std::size_t indexCount{0};
+    VertexQuantization quantization;
+    AABB bounds;
+    BoundingSphere sphere;
+    // empty unless generated on import; level 0 is the full mesh
+    std::vector<MeshLod> lods;
+    // only type and path are set; ids are assigned on upload
+    std::vector<Texture> textures;
+    // average cache miss ratio before and after the index optimization, 0
+    // when it didn't run
+    float acmrBefore{0.0f};
+    float acmrAfter{0.0f};
+
+    // storage for meshes that didn't come from the cache
+    std::vector<Vertex> vertices;
+    std::vector<PackedVertex> packedVertices;
+    std::vector<unsigned int> indices;
+    std::vector<std::uint16_t> shortIndices;
+
+    ImportedMesh() = default;
+    ImportedMesh(ImportedMesh&&) = default;
+    ImportedMesh& operator=(ImportedMesh&&) = default;
+    ImportedMesh(const ImportedMesh&) = delete;
+    ImportedMesh& operator=(const ImportedMesh&) = delete;
+
+    // bytes the mesh takes up on the GPU in the given format
+    std::size_t uploadSize(VertexFormat format) const;
+    // frees the CPU copy once it has been uploaded
+    void release();
+};
+
+// A model read from disk and processed up to the point where only GL calls
+// are left: meshes in their final vertex format and textures decoded. Needs
+// no GL context, so it can be built on any thread.
+struct ImportedModel {
+    std::string directory;
+    ImportOptions options;
+    std::vector<ImportedMesh> meshes;
+    // every texture the meshes use, once, relative to the directory, and its
+    // cache request
+    std::vector<std::string> texturePaths;
+    std::vector<TextureRequest> textures;
+    // keeps the cache file mapped while meshes point into it
+    std::shared_ptr<MeshCache> cache;
+    // false if the model could not be read
+    bool valid{false};
+};
+
+// reads a model, from its mesh cache when there is a valid one, else through
+// assimp, writing the cache for the next time. Thread-safe.
+ImportedModel importModel(const std::string& path, const ImportOptions& options);
+
 class Model {
     public:
         virtual void draw(const Shader& shader) const = 0;
@@ -38,19 +130,75 @@ class RawModel : public Model {
 
 class AssimpModel : public Model {
    public:
-    std::vector<Texture> textures_loaded;
+    // the model's textures by path relative to its directory. Holding the
+    // handles keeps them alive in the TextureCache.
+    std::unordered_map<std::string, TextureHandle> textures_loaded;
     std::vector<Mesh> meshes;
     std::string directory;
     bool gammaCorrection;
+    ImportOptions options;
+    // object space bounds of all meshes together
+    AABB bounds;
+
+    // imports and uploads the whole model before returning
+    AssimpModel(const std::string& path, bool gamma = false,
+                ImportOptions options = {});
+    // takes over an imported model without uploading any of it yet; see
+    // upload()
+    explicit AssimpModel(ImportedModel imported, bool gamma = false);
+
+    // uploads the textures and then the meshes still waiting, until at least
+    // byteBudget bytes went to the GPU or nothing is left. Always uploads at
+    // least one texture or mesh. Returns the bytes uploaded. Textures go
+    // through the uploader when given one.
+    std::size_t upload(std::size_t byteBudget,
+                       TextureUploader* uploader = nullptr);
+    // whether everything has been uploaded. Only resident models are culled;
+    // drawing a partially uploaded one draws the meshes uploaded so far.
+    bool resident() const;
 
-    AssimpModel(const std::string& path, bool gamma = false);
     void draw(const Shader& shader) const override;
+    // only draws the meshes whose bounds intersect the frustum, which has to
+    // be in the model's object space, i.e. built from projection * view *
+    // model
+    void draw(const Shader& shader, const Frustum& frustum,
+              CullingStats& stats) const;
+    // queues the meshes whose bounds intersect the frustum (in object space,
+    // as above) to be drawn at the given model transform, each at the level of
+    // detail lod selects for it, or at full detail without one
+    void submit(RenderQueue& queue, const Shader& shader,
+                const glm::mat4& transform, const Frustum& frustum,
+                CullingStats& stats, const LodSelector* lod = nullptr) const;
+    // the same, recording the draws into a list instead. Doesn't touch GL,
+    // so it can run off the GL thread, but not concurrently with another
+    // record() or submit() of the same model.
+    void record(DrawList& list, const Shader& shader,
+                const glm::mat4& transform, const Frustum& frustum,
+                CullingStats& stats, const LodSelector* lod = nullptr) const;
 
    private:
-    void loadModel(const std::string& path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+    // what's left to upload, and how far along it is
+    ImportedModel pending;
+    std::size_t texturesUploaded{0};
+    std::size_t meshesUploaded{0};
+    bool uploadComplete{false};
+    // per-mesh bounds in the layout cullBounds() expects
+    BoundsSoA meshBounds;
+    mutable std::vector<unsigned int> visibleMeshes;
+    // the level each mesh was last drawn at, for the selection's hysteresis
+    mutable std::vector<std::uint8_t> meshLevels;
+    // consecutive meshes waiting to be drawn with one multi-draw call
+    mutable std::vector<const Mesh*> batch;
+
+    void gatherBounds();
+    // culls the meshes into visibleMeshes and, with a LodSelector, selects
+    // each visible one's level into meshLevels. Returns whether it did.
+    bool selectVisible(const glm::mat4& transform, const Frustum& frustum,
+                       CullingStats& stats, const LodSelector* lod) const;
+    // queues a mesh, first drawing the queued ones if it can't join them
+    void batchDraw(const Shader& shader, const Mesh& mesh) const;
+    void flushBatch(const Shader& shader) const;
+    Texture findOrLoadTexture(const char* path, const std::string& typeName);
 };
 
 }  // namespace learning
@@ -0,0 +1,744 @@
+#include "obj_loader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// bytes of the file parsed per task
+const std::size_t PARSE_CHUNK = 1024 * 1024;
+// a corner without a texture coordinate or normal
+const std::uint32_t ABSENT = ~std::uint32_t{0};
+
+// exact powers of ten, for the fast float path
+const double POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                1e18, 1e19, 1e20, 1e21, 1e22};
+
+// a face corner, as zero-based indices into the file's attribute lists
+struct Corner {
+    std::uint32_t position;
+    std::uint32_t texCoord;
+    std::uint32_t normal;
+
+    bool operator==(const Corner& other) const {
+        return position == other.position && texCoord == other.texCoord &&
+               normal == other.normal;
+    }
+};
+
+// an o, g or usemtl line, taking effect from the given corner on
+struct GroupChange {
+    std::size_t corner;
+    bool material;
+    std::string name;
+};
+
+// what one chunk of the file holds
+struct Chunk {
+    const char* begin;
+    const char* end;
+    // v, vt and vn lines, counted in the first pass
+    std::size_t positions{0};
+    std::size_t texCoords{0};
+    std::size_t normals{0};
+    // triangulated faces, as three corners each
+    std::vector<Corner> corners;
+    std::vector<GroupChange> changes;
+    std::vector<std::string> libraries;
+    bool unsupported{false};
+};
+
+// the attribute lists of the whole file
+struct Attributes {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    std::vector<glm::vec3> normals;
+};
+
+// a run of faces sharing object and material, made into one mesh
+struct Segment {
+    std::size_t begin;
+    std::size_t end;
+    std::string object;
+    std::string material;
+};
+
+enum class LineType {
+    Other,
+    Position,
+    TexCoord,
+    Normal,
+    Face,
+    Object,
+    Material,
+    Library,
+    Unsupported
+};
+
+bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) ++p;
+    return p;
+}
+
+bool keywordIs(const char* begin, const char* end, const char* keyword) {
+    std::size_t length = std::strlen(keyword);
+    return static_cast<std::size_t>(end - begin) == length &&
+           std::memcmp(begin, keyword, length) == 0;
+}
+
+// the rest of the line without surrounding whitespace
+std::string restOfLine(const char* p, const char* end) {
+    p = skipSpaces(p, end);
+    while (end > p && isSpace(end[-1])) --end;
+    return std::string(p, end);
+}
+
+// classifies a line by its keyword and moves p past it
+LineType lineType(const char*& p, const char* end) {
+    p = skipSpaces(p, end);
+    const char* keyword = p;
+    while (p < end && !isSpace(*p)) ++p;
+    if (p == keyword || *keyword == '#') return LineType::Other;
+
+    switch (*keyword) {
+        case 'v':
+            if (keywordIs(keyword, p, "v")) return LineType::Position;
+            if (keywordIs(keyword, p, "vt")) return LineType::TexCoord;
+            if (keywordIs(keyword, p, "vn")) return LineType::Normal;
+            break;
+        case 'f':
+            if (keywordIs(keyword, p, "f")) return LineType::Face;
+            break;
+        case 'o':
+        case 'g':
+            if (p - keyword == 1) return LineType::Object;
+            break;
+        case 'u':
+            if (keywordIs(keyword, p, "usemtl")) return LineType::Material;
+            break;
+        case 'm':
+            if (keywordIs(keyword, p, "mtllib")) return LineType::Library;
+            break;
+        case 'l':
+        case 'p':
+            if (p - keyword == 1) return LineType::Unsupported;
+            break;
+        default:
+            break;
+    }
+    // free-form geometry
+    if (keywordIs(keyword, p, "cstype") || keywordIs(keyword, p, "curv") ||
+        keywordIs(keyword, p, "curv2") || keywordIs(keyword, p, "surf"))
+        return LineType::Unsupported;
+    return LineType::Other;
+}
+
+// calls line(begin, end) for every line in [begin, end), without its newline
+template <typename Function>
+void forEachLine(const char* begin, const char* end, Function&& line) {
+    while (begin < end) {
+        const char* newline = static_cast<const char*>(
+            std::memchr(begin, '\n', static_cast<std::size_t>(end - begin)));
+        const char* lineEnd = newline ? newline : end;
+        line(begin, lineEnd);
+        begin = newline ? newline + 1 : end;
+    }
+}
+
+// parses the number at p with strtod, for whatever the fast path can't take
+bool parseFloatSlow(const char*& p, const char* end, float& value) {
+    char buffer[64];
+    std::size_t length = 0;
+    while (p + length < end && !isSpace(p[length]) &&
+           length < sizeof(buffer) - 1) {
+        buffer[length] = p[length];
+        ++length;
+    }
+    buffer[length] = '\0';
+    char* parsed = nullptr;
+    double result = std::strtod(buffer, &parsed);
+    if (parsed == buffer) return false;
+    p += parsed - buffer;
+    value = static_cast<float>(result);
+    return true;
+}
+
+// parses the number at p and moves past it. Plain decimals with up to 19
+// significant digits and a small exponent are converted with a single exact
+// multiplication or division in double precision.
+bool parseFloat(const char*& p, const char* end, float& value) {
+    p = skipSpaces(p, end);
+    const char* q = p;
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+')) negative = *q++ == '-';
+
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    bool exact = true;
+    for (; q < end && isDigit(*q); ++q) {
+        any = true;
+        if (digits == 19) {
+            exact = false;
+            continue;
+        }
+        mantissa = mantissa * 10 + static_cast<std::uint64_t>(*q - '0');
+        if (mantissa) ++digits;
+    }
+    if (q < end && *q == '.') {
+        for (++q; q < end && isDigit(*q); ++q) {
+            any = true;
+            if (digits == 19) {
+                exact = false;
+                continue;
+            }
+            mantissa = mantissa * 10 + static_cast<std::uint64_t>(*q - '0');
+            if (mantissa) ++digits;
+            --exponent;
+        }
+    }
+    // nan, inf and the like
+    if (!any) return parseFloatSlow(p, end, value);
+
+    if (q < end && (*q == 'e' || *q == 'E')) {
+        const char* e = q + 1;
+        bool negativeExponent = false;
+        if (e < end && (*e == '-' || *e == '+'))
+            negativeExponent = *e++ == '-';
+        if (e < end && isDigit(*e)) {
+            int written = 0;
+            for (; e < end && isDigit(*e); ++e)
+                if (written < 10000) written = written * 10 + (*e - '0');
+            exponent += negativeExponent ? -written : written;
+            q = e;
+        }
+    }
+
+    if (!exact || mantissa > (std::uint64_t{1} << 53) || exponent < -22 ||
+        exponent > 22)
+        return parseFloatSlow(p, end, value);
+
+    double result = static_cast<double>(mantissa);
+    if (exponent < 0)
+        result /= POWERS_OF_TEN[-exponent];
+    else
+        result *= POWERS_OF_TEN[exponent];
+    value = static_cast<float>(negative ? -result : result);
+    p = q;
+    return true;
+}
+
+bool parseIndex(const char*& p, const char* end, std::int64_t& value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+    if (p >= end || !isDigit(*p)) return false;
+    std::int64_t result = 0;
+    for (; p < end && isDigit(*p); ++p)
+        if (result < (std::int64_t{1} << 40)) result = result * 10 + (*p - '0');
+    value = negative ? -result : result;
+    return true;
+}
+
+// turns a 1-based or negative (relative to the attributes read so far) index
+// into a zero-based one, checking it against the file's total
+bool resolveIndex(std::int64_t index, std::size_t read, std::size_t total,
+                  std::uint32_t& resolved) {
+    std::int64_t zeroBased =
+        index > 0 ? index - 1 : static_cast<std::int64_t>(read) + index;
+    if (index == 0 || zeroBased < 0 ||
+        zeroBased >= static_cast<std::int64_t>(total) ||
+        zeroBased >= static_cast<std::int64_t>(ABSENT))
+        return false;
+    resolved = static_cast<std::uint32_t>(zeroBased);
+    return true;
+}
+
+// first pass: counts the attributes a chunk defines, so the second pass knows
+// where in the file's lists each chunk's attributes go
+void countAttributes(Chunk& chunk) {
+    forEachLine(chunk.begin, chunk.end, [&](const char* p, const char* end) {
+        switch (lineType(p, end)) {
+            case LineType::Position:
+                ++chunk.positions;
+                break;
+            case LineType::TexCoord:
+                ++chunk.texCoords;
+                break;
+            case LineType::Normal:
+                ++chunk.normals;
+                break;
+            default:
+                break;
+        }
+    });
+}
+
+// second pass: parses a chunk's attributes into the file's lists, starting at
+// the chunk's offsets, and triangulates its faces
+void parseChunk(Chunk& chunk, std::size_t positionBase,
+                std::size_t texCoordBase, std::size_t normalBase,
+                Attributes& attributes) {
+    std::size_t positionsRead = positionBase;
+    std::size_t texCoordsRead = texCoordBase;
+    std::size_t normalsRead = normalBase;
+    std::vector<Corner> face;
+
+    forEachLine(chunk.begin, chunk.end, [&](const char* p, const char* end) {
+        if (chunk.unsupported) return;
+        // line continuations
+        const char* last = end;
+        while (last > p && isSpace(last[-1])) --last;
+        if (last > p && last[-1] == '\\') {
+            chunk.unsupported = true;
+            return;
+        }
+
+        switch (lineType(p, end)) {
+            case LineType::Position: {
+                glm::vec3& position = attributes.positions[positionsRead++];
+                if (!parseFloat(p, end, position.x) ||
+                    !parseFloat(p, end, position.y) ||
+                    !parseFloat(p, end, position.z))
+                    chunk.unsupported = true;
+                break;
+            }
+            case LineType::TexCoord: {
+                glm::vec2& texCoord = attributes.texCoords[texCoordsRead++];
+                if (!parseFloat(p, end, texCoord.x))
+                    chunk.unsupported = true;
+                // v is optional
+                else if (!parseFloat(p, end, texCoord.y))
+                    texCoord.y = 0.0f;
+                break;
+            }
+            case LineType::Normal: {
+                glm::vec3& normal = attributes.normals[normalsRead++];
+                if (!parseFloat(p, end, normal.x) ||
+                    !parseFloat(p, end, normal.y) ||
+                    !parseFloat(p, end, normal.z))
+                    chunk.unsupported = true;
+                break;
+            }
+            case LineType::Face: {
+                face.clear();
+                for (p = skipSpaces(p, end); p < end; p = skipSpaces(p, end)) {
+                    Corner corner{0, ABSENT, ABSENT};
+                    std::int64_t index = 0;
+                    bool valid = parseIndex(p, end, index) &&
+                                 resolveIndex(index, positionsRead,
+                                              attributes.positions.size(),
+                                              corner.position);
+                    if (valid && p < end && *p == '/') {
+                        ++p;
+                        if (p < end && *p != '/')
+                            valid = parseIndex(p, end, index) &&
+                                    resolveIndex(index, texCoordsRead,
+                                                 attributes.texCoords.size(),
+                                                 corner.texCoord);
+                        if (valid && p < end && *p == '/') {
+                            ++p;
+                            valid = parseIndex(p, end, index) &&
+                                    resolveIndex(index, normalsRead,
+                                                 attributes.normals.size(),
+                                                 corner.normal);
+                        }
+                    }
+                    if (!valid || (p < end && !isSpace(*p))) {
+                        chunk.unsupported = true;
+                        return;
+                    }
+                    face.push_back(corner);
+                }
+                // fan around the first corner
+                for (std::size_t i = 2; i < face.size(); ++i) {
+                    chunk.corners.push_back(face[0]);
+                    chunk.corners.push_back(face[i - 1]);
+                    chunk.corners.push_back(face[i]);
+                }
+                break;
+            }
+            case LineType::Object:
+                chunk.changes.push_back(
+                    GroupChange{chunk.corners.size(), false, restOfLine(p, end)});
+                break;
+            case LineType::Material:
+                chunk.changes.push_back(
+                    GroupChange{chunk.corners.size(), true, restOfLine(p, end)});
+                break;
+            case LineType::Library:
+                chunk.libraries.push_back(restOfLine(p, end));
+                break;
+            case LineType::Unsupported:
+                chunk.unsupported = true;
+                break;
+            case LineType::Other:
+                break;
+        }
+    });
+}
+
+// splits the file into chunks of about PARSE_CHUNK bytes, each ending after a
+// newline
+std::vector<Chunk> splitIntoChunks(const char* data, std::size_t size) {
+    std::vector<Chunk> chunks;
+    const char* end = data + size;
+    const char* begin = data;
+    while (begin < end) {
+        const char* chunkEnd = end;
+        if (static_cast<std::size_t>(end - begin) > PARSE_CHUNK) {
+            const char* newline = static_cast<const char*>(std::memchr(
+                begin + PARSE_CHUNK, '\n',
+                static_cast<std::size_t>(end - begin) - PARSE_CHUNK));
+            if (newline) chunkEnd = newline + 1;
+        }
+        Chunk chunk;
+        chunk.begin = begin;
+        chunk.end = chunkEnd;
+        chunks.push_back(std::move(chunk));
+        begin = chunkEnd;
+    }
+    return chunks;
+}
+
+// cuts the triangulated faces into segments wherever the object or material
+// changes, merging runs that end up with the same names
+std::vector<Segment> findSegments(const std::vector<GroupChange>& changes,
+                                  std::size_t cornerCount) {
+    std::vector<Segment> segments;
+    std::string object;
+    std::string material;
+    std::size_t begin = 0;
+    auto close = [&](std::size_t end) {
+        if (end == begin) return;
+        if (!segments.empty() && segments.back().end == begin &&
+            segments.back().object == object &&
+            segments.back().material == material)
+            segments.back().end = end;
+        else
+            segments.push_back(Segment{begin, end, object, material});
+        begin = end;
+    };
+    for (const GroupChange& change : changes) {
+        close(change.corner);
+        if (change.material)
+            material = change.name;
+        else
+            object = change.name;
+    }
+    close(cornerCount);
+    return segments;
+}
+
+std::uint64_t hashCorner(const Corner& corner) {
+    std::uint64_t hash = corner.position * 0x9E3779B97F4A7C15ull;
+    hash ^= (corner.texCoord + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+    hash ^= (corner.normal + 0x165667B19E3779F9ull) * 0x27D4EB2F165667C5ull;
+    return hash ^ (hash >> 29);
+}
+
+// welds identical corners of a segment into one vertex each, filling indices
+// and returning the distinct corners in order of first use
+std::vector<Corner> weldCorners(const Corner* corners, std::size_t count,
+                                std::vector<unsigned int>& indices) {
+    std::size_t tableSize = 16;
+    while (tableSize < count * 2) tableSize *= 2;
+    const std::size_t mask = tableSize - 1;
+    // 1 + index into unique, 0 for an empty slot
+    std::vector<std::uint32_t> table(tableSize, 0);
+    std::vector<Corner> unique;
+    unique.reserve(count / 2);
+
+    indices.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const Corner& corner = corners[i];
+        for (std::size_t slot = hashCorner(corner) & mask;;
+             slot = (slot + 1) & mask) {
+            if (table[slot] == 0) {
+                unique.push_back(corner);
+                table[slot] = static_cast<std::uint32_t>(unique.size());
+                indices[i] = static_cast<unsigned int>(unique.size() - 1);
+                break;
+            }
+            if (unique[table[slot] - 1] == corner) {
+                indices[i] = table[slot] - 1;
+                break;
+            }
+        }
+    }
+    return unique;
+}
+
+// smooth normals for meshes without any: vertices sharing a position get the
+// average of the normals of the faces around it
+void generateNormals(const std::vector<Corner>& unique,
+                     const std::vector<unsigned int>& indices,
+                     std::vector<Vertex>& vertices) {
+    std::vector<std::uint32_t> order(unique.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(),
+              [&](std::uint32_t a, std::uint32_t b) {
+                  return unique[a].position < unique[b].position;
+              });
+    std::vector<std::uint32_t> group(unique.size());
+    std::size_t groups = 0;
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        if (i == 0 ||
+            unique[order[i]].position != unique[order[i - 1]].position)
+            ++groups;
+        group[order[i]] = static_cast<std::uint32_t>(groups - 1);
+    }
+
+    std::vector<glm::vec3> sums(groups, glm::vec3(0.0f));
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const glm::vec3& a = vertices[indices[i]].position;
+        const glm::vec3& b = vertices[indices[i + 1]].position;
+        const glm::vec3& c = vertices[indices[i + 2]].position;
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float length = glm::length(normal);
+        if (length <= 0.0f) continue;
+        normal /= length;
+        for (std::size_t k = 0; k < 3; ++k)
+            sums[group[indices[i + k]]] += normal;
+    }
+    for (std::size_t v = 0; v < vertices.size(); ++v) {
+        const glm::vec3& sum = sums[group[v]];
+        float length = glm::length(sum);
+        if (length > 0.0f) vertices[v].normal = sum / length;
+    }
+}
+
+// projects v onto the plane of normal and normalizes it, or returns zero
+glm::vec3 orthogonalize(const glm::vec3& v, const glm::vec3& normal) {
+    glm::vec3 projected = v - normal * glm::dot(v, normal);
+    float length = glm::length(projected);
+    return length > 0.0f ? projected / length : glm::vec3(0.0f);
+}
+
+// tangents and bitangents the way assimp's CalcTangentSpace computes them:
+// from the texture coordinates as they are in the file, before they're
+// flipped, made orthogonal to each vertex normal and averaged over the faces
+// around the vertex
+void computeTangents(const std::vector<unsigned int>& indices,
+                     std::vector<Vertex>& vertices) {
+    std::vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> bitangents(vertices.size(), glm::vec3(0.0f));
+    for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const Vertex& v0 = vertices[indices[i]];
+        const Vertex& v1 = vertices[indices[i + 1]];
+        const Vertex& v2 = vertices[indices[i + 2]];
+        glm::vec3 edge1 = v1.position - v0.position;
+        glm::vec3 edge2 = v2.position - v0.position;
+        // the stored v is flipped, so its differences change sign
+        float sx = v1.texCoords.x - v0.texCoords.x;
+        float sy = v0.texCoords.y - v1.texCoords.y;
+        float tx = v2.texCoords.x - v0.texCoords.x;
+        float ty = v0.texCoords.y - v2.texCoords.y;
+        float direction = (tx * sy - ty * sx) < 0.0f ? -1.0f : 1.0f;
+        // degenerate in texture space: use the default directions
+        if (sx * ty == sy * tx) {
+            sx = 0.0f;
+            sy = 1.0f;
+            tx = 1.0f;
+            ty = 0.0f;
+        }
+        glm::vec3 tangent = (edge2 * sy - edge1 * ty) * direction;
+        glm::vec3 bitangent = (edge2 * sx - edge1 * tx) * direction;
+        for (std::size_t k = 0; k < 3; ++k) {
+            unsigned int v = indices[i + k];
+            tangents[v] += orthogonalize(tangent, vertices[v].normal);
+            bitangents[v] += orthogonalize(bitangent, vertices[v].normal);
+        }
+    }
+    for (std::size_t v = 0; v < vertices.size(); ++v) {
+        vertices[v].tangent = orthogonalize(tangents[v], vertices[v].normal);
+        vertices[v].bitangent =
+            orthogonalize(bitangents[v], vertices[v].normal);
+    }
+}
+
+// turns one segment of the file into a welded mesh with the attributes
+// assimp would have produced for it
+void buildMesh(const Segment& segment, const Corner* corners,
+               const Attributes& attributes, ObjMesh& mesh) {
+    mesh.name = segment.object;
+    std::vector<Corner> unique = weldCorners(
+        corners + segment.begin, segment.end - segment.begin, mesh.indices);
+
+    bool hasNormals = true;
+    bool hasTexCoords = false;
+    for (const Corner& corner : unique) {
+        hasNormals = hasNormals && corner.normal != ABSENT;
+        hasTexCoords = hasTexCoords || corner.texCoord != ABSENT;
+    }
+
+    // zeroed, like the vertices converted from assimp
+    mesh.vertices.resize(unique.size());
+    for (std::size_t v = 0; v < unique.size(); ++v) {
+        const Corner& corner = unique[v];
+        Vertex& vertex = mesh.vertices[v];
+        vertex.position = attributes.positions[corner.position];
+        if (hasNormals) vertex.normal = attributes.normals[corner.normal];
+        if (corner.texCoord != ABSENT) {
+            const glm::vec2& texCoord = attributes.texCoords[corner.texCoord];
+            vertex.texCoords = glm::vec2(texCoord.x, 1.0f - texCoord.y);
+        }
+    }
+    if (!hasNormals) generateNormals(unique, mesh.indices, mesh.vertices);
+    if (hasTexCoords) computeTangents(mesh.indices, mesh.vertices);
+}
+
+// reads the materials of an MTL library, keeping only their texture maps
+void loadMaterials(const std::string& path,
+                   std::vector<ObjMaterial>& materials) {
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        std::cout << "ERROR::OBJ_LOADER::MTL_NOT_FOUND: " << path << '\n';
+        return;
+    }
+    const char* data = reinterpret_cast<const char*>(file.data());
+    ObjMaterial* material = nullptr;
+    forEachLine(data, data + file.size(), [&](const char* p, const char* end) {
+        p = skipSpaces(p, end);
+        const char* keywordBegin = p;
+        while (p < end && !isSpace(*p)) ++p;
+        std::string keyword(keywordBegin, p);
+        std::transform(keyword.begin(), keyword.end(), keyword.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+
+        if (keyword == "newmtl") {
+            materials.emplace_back();
+            material = &materials.back();
+            material->name = restOfLine(p, end);
+            return;
+        }
+        if (!material) return;
+        std::string* map = nullptr;
+        if (keyword == "map_kd")
+            map = &material->diffuse;
+        else if (keyword == "map_ks")
+            map = &material->specular;
+        else if (keyword == "map_bump" || keyword == "bump")
+            map = &material->bump;
+        else if (keyword == "map_ka")
+            map = &material->ambient;
+        if (!map) return;
+
+        // options like -bm 1.0 come first, the file name is the last token
+        while (end > p && isSpace(end[-1])) --end;
+        const char* name = end;
+        while (name > p && !isSpace(name[-1])) --name;
+        *map = std::string(name, end);
+    });
+}
+
+}  // namespace
+
+bool isObjFile(const std::string& path) {
+    std::size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return extension == "obj";
+}
+
+bool loadObj(const std::string& path, ObjModel& model) {
+    MappedFile file(path);
+    if (!file.isOpen()) return false;
+    const char* data = reinterpret_cast<const char*>(file.data());
+
+    ThreadPool& pool = ThreadPool::shared();
+    std::vector<Chunk> chunks = splitIntoChunks(data, file.size());
+    pool.parallelFor(chunks.size(),
+                     [&](std::size_t i) { countAttributes(chunks[i]); });
+
+    // each chunk's attributes go after those of the chunks before it
+    std::vector<std::size_t> positionBases(chunks.size());
+    std::vector<std::size_t> texCoordBases(chunks.size());
+    std::vector<std::size_t> normalBases(chunks.size());
+    Attributes attributes;
+    std::size_t positions = 0;
+    std::size_t texCoords = 0;
+    std::size_t normals = 0;
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        positionBases[i] = positions;
+        texCoordBases[i] = texCoords;
+        normalBases[i] = normals;
+        positions += chunks[i].positions;
+        texCoords += chunks[i].texCoords;
+        normals += chunks[i].normals;
+    }
+    attributes.positions.resize(positions);
+    attributes.texCoords.resize(texCoords);
+    attributes.normals.resize(normals);
+
+    pool.parallelFor(chunks.size(), [&](std::size_t i) {
+        parseChunk(chunks[i], positionBases[i], texCoordBases[i],
+                   normalBases[i], attributes);
+    });
+    for (const Chunk& chunk : chunks)
+        if (chunk.unsupported) return false;
+
+    // gather the faces and group changes of every chunk
+    std::vector<std::size_t> cornerBases(chunks.size());
+    std::size_t cornerCount = 0;
+    std::vector<GroupChange> changes;
+    std::vector<std::string> libraries;
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+        cornerBases[i] = cornerCount;
+        for (GroupChange& change : chunks[i].changes) {
+            change.corner += cornerCount;
+            changes.push_back(std::move(change));
+        }
+        for (std::string& library : chunks[i].libraries)
+            if (std::find(libraries.begin(), libraries.end(), library) ==
+                libraries.end())
+                libraries.push_back(std::move(library));
+        cornerCount += chunks[i].corners.size();
+    }
+    std::vector<Corner> corners(cornerCount);
+    pool.parallelFor(chunks.size(), [&](std::size_t i) {
+        std::copy(chunks[i].corners.begin(), chunks[i].corners.end(),
+                  corners.begin() + static_cast<std::ptrdiff_t>(cornerBases[i]));
+        chunks[i].corners = {};
+    });
+
+    std::string directory = path.substr(0, path.find_last_of('/'));
+    for (const std::string& library : libraries)
+        loadMaterials(directory + '/' + library, model.materials);
+
+    std::vector<Segment> segments = findSegments(changes, cornerCount);
+    model.meshes.resize(segments.size());
+    pool.parallelFor(segments.size(), [&](std::size_t i) {
+        buildMesh(segments[i], corners.data(), attributes, model.meshes[i]);
+    });
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+        const std::string& name = segments[i].material;
+        for (std::size_t m = 0; m < model.materials.size(); ++m)
+            if (model.materials[m].name == name) {
+                model.meshes[i].material = static_cast<int>(m);
+                break;
+            }
+    }
+    return true;
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,55 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+
+namespace personal::renderer::utility {
+
+// The texture maps of an MTL material, as paths relative to the model, empty
+// when the material has none
+struct ObjMaterial {
+    std::string name;
+    std::string diffuse;   // map_Kd
+    std::string specular;  // map_Ks
+    std::string bump;      // map_Bump / bump
+    std::string ambient;   // map_Ka
+};
+
+// One mesh of an OBJ file: the faces of one object using one material,
+// triangulated and with identical corners welded into one vertex
+struct ObjMesh {
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    // index into ObjModel::materials, or -1 without a material
+    int material{-1};
+};
+
+struct ObjModel {
+    std::vector<ObjMesh> meshes;
+    std::vector<ObjMaterial> materials;
+};
+
+// whether a path names a Wavefront OBJ file
+bool isObjFile(const std::string& path);
+
+// Reads a Wavefront OBJ file and the MTL libraries it references without
+// assimp, producing the same vertices assimp does with IMPORT_FLAGS:
+// polygons fan triangulated, texture coordinates flipped vertically, smooth
+// normals generated for meshes that have none, and tangents and bitangents
+// computed from the texture coordinates.
+//
+// The file is mapped and split into line-aligned chunks that are parsed on
+// the shared thread pool, with a fast path for plain decimal floats. A new
+// mesh starts whenever the object, group or material changes; meshes are
+// welded on the pool too. Returns false, leaving the model to assimp, if the
+// file can't be read or uses anything but polygonal faces (lines, points,
+// free-form geometry, line continuations) or out of range indices.
+bool loadObj(const std::string& path, ObjModel& model);
+
+}  // namespace personal::renderer::utility
+
+#endif  // OBJ_LOADER_H
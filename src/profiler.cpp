@@ -0,0 +1,285 @@
+#include "profiler.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "imgui.h"
+
+namespace personal::renderer::utility {
+
+namespace {
+
+const char* TRACE_PATH = "profile_trace.json";
+
+double microseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+void writeJsonString(std::ostream& stream, const char* text) {
+    stream << '"';
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') stream << '\\';
+        stream << *c;
+    }
+    stream << '"';
+}
+
+void writeEvent(std::ostream& stream, const char* name, int thread,
+                double begin, double duration) {
+    stream << "{\"name\":";
+    writeJsonString(stream, name);
+    stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+           << ",\"ts\":" << begin << ",\"dur\":" << duration << '}';
+}
+
+}  // namespace
+
+Profiler::Profiler() : epoch(Clock::now()) {}
+
+Profiler::~Profiler() {
+    for (Frame& frame : frames)
+        if (!frame.queries.empty())
+            glDeleteQueries(static_cast<GLsizei>(frame.queries.size()),
+                            frame.queries.data());
+}
+
+void Profiler::beginFrame() {
+    // this slot was last used QUERY_FRAMES frames ago, so its queries have
+    // most likely finished by now
+    Frame& frame = currentFrame();
+    if (frame.pending) resolve(frame);
+
+    frame.records.clear();
+    frame.queriesUsed = 0;
+    frame.pending = true;
+    openScopes.clear();
+    beginScope("Frame");
+}
+
+void Profiler::endFrame() {
+    // close anything left open, then the frame scope itself
+    while (!openScopes.empty()) endScope();
+    ++frameIndex;
+}
+
+void Profiler::beginScope(const char* name) {
+    Frame& frame = currentFrame();
+    Record record{name, static_cast<int>(openScopes.size()), {}, {},
+                  issueTimestamp(frame), 0};
+    record.cpuBegin = Clock::now();
+
+    openScopes.push_back(frame.records.size());
+    frame.records.push_back(record);
+}
+
+void Profiler::endScope() {
+    if (openScopes.empty()) return;
+
+    Frame& frame = currentFrame();
+    Record& record = frame.records[openScopes.back()];
+    record.cpuEnd = Clock::now();
+    record.endQuery = issueTimestamp(frame);
+    openScopes.pop_back();
+}
+
+void Profiler::drawImGui() {
+    ImGui::Begin("Profiler");
+    ImGui::Text("Frames: %zu, GPU results dropped: %zu", framesResolved,
+                gpuFramesDropped);
+    if (ImGui::Button("Save trace")) {
+        traceStatus = writeChromeTrace(TRACE_PATH)
+                          ? std::string("wrote ") + TRACE_PATH
+                          : std::string("failed to write ") + TRACE_PATH;
+    }
+    if (!traceStatus.empty()) {
+        ImGui::SameLine();
+        ImGui::TextUnformatted(traceStatus.c_str());
+    }
+
+    if (ImGui::BeginTable("scopes", 9,
+                          ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders)) {
+        ImGui::TableSetupColumn("Scope (ms)");
+        ImGui::TableSetupColumn("CPU avg");
+        ImGui::TableSetupColumn("CPU p50");
+        ImGui::TableSetupColumn("CPU p95");
+        ImGui::TableSetupColumn("CPU p99");
+        ImGui::TableSetupColumn("GPU avg");
+        ImGui::TableSetupColumn("GPU p50");
+        ImGui::TableSetupColumn("GPU p95");
+        ImGui::TableSetupColumn("GPU p99");
+        ImGui::TableHeadersRow();
+
+        for (const ScopeStats& scope : scopes) {
+            Summary cpu = summarize(scope.cpu);
+            Summary gpu = summarize(scope.gpu);
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s", scope.depth * 2, "", scope.name.c_str());
+            for (double value : {cpu.average, cpu.p50, cpu.p95, cpu.p99,
+                                 gpu.average, gpu.p50, gpu.p95, gpu.p99}) {
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", value);
+            }
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const {
+    std::ofstream stream(path, std::ios::trunc);
+    if (!stream) {
+        std::cout << "ERROR::PROFILER::FILE_NOT_WRITABLE: " << path << '\n';
+        return false;
+    }
+
+    stream << std::fixed;
+    stream.precision(3);
+    stream << "{\"traceEvents\":[\n"
+           << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+              "\"args\":{\"name\":\"CPU\"}},\n"
+           << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+              "\"args\":{\"name\":\"GPU\"}}";
+    for (const std::vector<TraceEvent>& frame : trace) {
+        for (const TraceEvent& event : frame) {
+            stream << ",\n";
+            writeEvent(stream, event.name, 1, event.cpuBegin,
+                       event.cpuDuration);
+            if (event.hasGpu) {
+                stream << ",\n";
+                writeEvent(stream, event.name, 2, event.gpuBegin,
+                           event.gpuDuration);
+            }
+        }
+    }
+    stream << "\n]}\n";
+
+    if (!stream) {
+        std::cout << "ERROR::PROFILER::WRITE_FAILED: " << path << '\n';
+        return false;
+    }
+    return true;
+}
+
+Profiler::Frame& Profiler::currentFrame() {
+    return frames[frameIndex % QUERY_FRAMES];
+}
+
+std::size_t Profiler::issueTimestamp(Frame& frame) {
+    if (frame.queriesUsed == frame.queries.size()) {
+        unsigned int query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    glQueryCounter(frame.queries[frame.queriesUsed], GL_TIMESTAMP);
+    return frame.queriesUsed++;
+}
+
+void Profiler::resolve(Frame& frame) {
+    frame.pending = false;
+    if (frame.records.empty()) return;
+
+    // never wait: if the GPU is more than QUERY_FRAMES behind, this frame
+    // only contributes CPU timings
+    bool gpuReady = true;
+    for (std::size_t i = 0; i < frame.queriesUsed && gpuReady; ++i) {
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE,
+                           &available);
+        gpuReady = available != 0;
+    }
+    std::vector<GLuint64> timestamps;
+    if (gpuReady) {
+        timestamps.resize(frame.queriesUsed);
+        for (std::size_t i = 0; i < frame.queriesUsed; ++i)
+            glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT,
+                                  &timestamps[i]);
+    } else {
+        ++gpuFramesDropped;
+    }
+
+    // GPU time is on its own clock; line the start of the frame up with the
+    // CPU's so both timelines read sensibly side by side in the trace
+    const Record& frameRecord = frame.records.front();
+    double frameBegin = microseconds(frameRecord.cpuBegin - epoch);
+
+    std::vector<TraceEvent> events;
+    events.reserve(frame.records.size());
+    for (const Record& record : frame.records) {
+        TraceEvent event{record.name,
+                         microseconds(record.cpuBegin - epoch),
+                         microseconds(record.cpuEnd - record.cpuBegin),
+                         gpuReady,
+                         0.0,
+                         0.0};
+
+        ScopeStats& stats = statsFor(record.name, record.depth);
+        addSample(stats.cpu, stats.nextCpu, event.cpuDuration / 1000.0);
+
+        if (gpuReady) {
+            GLuint64 begin = timestamps[record.beginQuery];
+            GLuint64 end = std::max(begin, timestamps[record.endQuery]);
+            GLuint64 origin = timestamps[frameRecord.beginQuery];
+            // nanoseconds to microseconds
+            event.gpuBegin =
+                frameBegin + static_cast<double>(begin - origin) / 1000.0;
+            event.gpuDuration = static_cast<double>(end - begin) / 1000.0;
+            addSample(stats.gpu, stats.nextGpu, event.gpuDuration / 1000.0);
+        }
+        events.push_back(event);
+    }
+
+    trace.push_back(std::move(events));
+    if (trace.size() > HISTORY_FRAMES) trace.pop_front();
+    ++framesResolved;
+}
+
+Profiler::ScopeStats& Profiler::statsFor(const char* name, int depth) {
+    for (ScopeStats& scope : scopes)
+        if (scope.depth == depth && scope.name == name) return scope;
+    scopes.push_back(ScopeStats{name, depth, {}, {}, 0, 0});
+    return scopes.back();
+}
+
+void Profiler::addSample(std::vector<double>& samples, std::size_t& next,
+                         double value) {
+    if (samples.size() < HISTORY_FRAMES)
+        samples.push_back(value);
+    else
+        samples[next] = value;
+    next = (next + 1) % HISTORY_FRAMES;
+}
+
+Profiler::Summary Profiler::summarize(const std::vector<double>& samples) {
+    Summary summary;
+    if (samples.empty()) return summary;
+
+    std::vector<double> sorted(samples);
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&sorted](double p) {
+        std::size_t index = static_cast<std::size_t>(
+            p * static_cast<double>(sorted.size()));
+        return sorted[std::min(index, sorted.size() - 1)];
+    };
+
+    double total = 0.0;
+    for (double sample : sorted) total += sample;
+    summary.average = total / static_cast<double>(sorted.size());
+    summary.p50 = percentile(0.50);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    return summary;
+}
+
+ProfileScope::ProfileScope(Profiler& profiler, const char* name)
+    : profiler(profiler) {
+    profiler.beginScope(name);
+}
+
+ProfileScope::~ProfileScope() { profiler.endScope(); }
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,132 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace personal::renderer::utility {
+
+// Hierarchical frame profiler measuring named scopes on the CPU and, with GL
+// timestamp queries, on the GPU.
+//
+// GPU queries are read back QUERY_FRAMES frames after they were issued, from
+// a separate query pool per frame in flight, so the profiler never waits for
+// the GPU. The statistics therefore lag a couple of frames behind. Timestamps
+// are used instead of GL_TIME_ELAPSED because elapsed time queries can't be
+// nested.
+//
+// Everything has to be called on the thread owning the GL context. Scope
+// names must be string literals (or otherwise outlive the profiler).
+class Profiler {
+   public:
+    static const std::size_t QUERY_FRAMES = 3;
+    // frames kept for the percentiles and the trace export
+    static const std::size_t HISTORY_FRAMES = 300;
+
+    struct Summary {
+        double average{0.0};
+        double p50{0.0};
+        double p95{0.0};
+        double p99{0.0};
+    };
+
+    Profiler();
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // frames are scopes of their own, named "Frame"
+    void beginFrame();
+    void endFrame();
+
+    void beginScope(const char* name);
+    void endScope();
+
+    // draws the "Profiler" window with the rolling timings of every scope
+    void drawImGui();
+    // writes the history as Chrome trace events (chrome://tracing, Perfetto),
+    // with the CPU and GPU timelines as separate threads
+    bool writeChromeTrace(const std::string& path) const;
+
+    // mean and percentiles of a set of samples, all zero when empty
+    static Summary summarize(const std::vector<double>& samples);
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Record {
+        const char* name;
+        int depth;
+        Clock::time_point cpuBegin;
+        Clock::time_point cpuEnd;
+        std::size_t beginQuery;
+        std::size_t endQuery;
+    };
+
+    // everything recorded during one frame, and the queries it issued
+    struct Frame {
+        std::vector<Record> records;
+        std::vector<unsigned int> queries;
+        std::size_t queriesUsed{0};
+        bool pending{false};
+    };
+
+    // rolling millisecond timings of one scope
+    struct ScopeStats {
+        std::string name;
+        int depth;
+        std::vector<double> cpu;
+        std::vector<double> gpu;
+        std::size_t nextCpu{0};
+        std::size_t nextGpu{0};
+    };
+
+    // one resolved scope, in microseconds since the profiler was created
+    struct TraceEvent {
+        const char* name;
+        double cpuBegin;
+        double cpuDuration;
+        bool hasGpu;
+        double gpuBegin;
+        double gpuDuration;
+    };
+
+    Clock::time_point epoch;
+    Frame frames[QUERY_FRAMES];
+    std::size_t frameIndex{0};
+    std::vector<std::size_t> openScopes;
+    std::vector<ScopeStats> scopes;
+    std::deque<std::vector<TraceEvent>> trace;
+    std::size_t framesResolved{0};
+    std::size_t gpuFramesDropped{0};
+    std::string traceStatus;
+
+    Frame& currentFrame();
+    std::size_t issueTimestamp(Frame& frame);
+    // reads back a frame recorded QUERY_FRAMES ago into the statistics
+    void resolve(Frame& frame);
+    ScopeStats& statsFor(const char* name, int depth);
+    static void addSample(std::vector<double>& samples, std::size_t& next,
+                          double value);
+};
+
+// Measures the enclosing block as a scope of the given profiler
+class ProfileScope {
+   public:
+    ProfileScope(Profiler& profiler, const char* name);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+   private:
+    Profiler& profiler;
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // PROFILER_H
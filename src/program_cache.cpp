@@ -0,0 +1,179 @@
+#include "program_cache.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <utility>
+
+#include "mapped_file.h"
+
+namespace personal::renderer::utility {
+
+namespace {
+
+const char MAGIC[4] = {'L', 'O', 'P', 'B'};
+// bump when the file layout changes
+const std::uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct FileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t key;
+    std::uint32_t format;
+    std::uint32_t size;
+    double compileMilliseconds;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// FNV-1a, continuing from hash
+std::uint64_t hashBytes(const void* data, std::size_t size,
+                        std::uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::uint64_t hashString(const char* text, std::uint64_t hash) {
+    if (!text) text = "";
+    // include the terminator so concatenations can't collide
+    return hashBytes(text, std::strlen(text) + 1, hash);
+}
+
+}  // namespace
+
+ProgramCache& ProgramCache::shared() {
+    static ProgramCache cache;
+    return cache;
+}
+
+ProgramCache::ProgramCache(std::string directory)
+    : directory(std::move(directory)) {
+    if (GLAD_GL_VERSION_4_1) {
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = formats > 0;
+    }
+
+    driverHash =
+        hashBytes(&PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION));
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        driverHash = hashString(
+            reinterpret_cast<const char*>(glGetString(name)), driverHash);
+}
+
+bool ProgramCache::enabled() const { return supported; }
+
+std::uint64_t ProgramCache::key(
+    const std::vector<const std::string*>& sources) const {
+    std::uint64_t hash = driverHash;
+    for (const std::string* source : sources) {
+        std::uint64_t size = source ? source->size() : 0;
+        hash = hashBytes(&size, sizeof(size), hash);
+        if (source) hash = hashBytes(source->data(), source->size(), hash);
+    }
+    return hash;
+}
+
+unsigned int ProgramCache::load(std::uint64_t key) {
+    if (!supported) {
+        ++cacheStats.misses;
+        return 0;
+    }
+    Clock::time_point begin = Clock::now();
+    MappedFile file(pathOf(key));
+    FileHeader header{};
+    if (!file.isOpen() || file.size() < sizeof(FileHeader)) {
+        ++cacheStats.misses;
+        return 0;
+    }
+    std::memcpy(&header, file.data(), sizeof(FileHeader));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != PROGRAM_CACHE_VERSION || header.key != key ||
+        file.size() < sizeof(FileHeader) + header.size) {
+        ++cacheStats.misses;
+        return 0;
+    }
+
+    unsigned int program = glCreateProgram();
+    glProgramBinary(program, header.format, file.data() + sizeof(FileHeader),
+                    static_cast<GLsizei>(header.size));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // compiled again and replaced by the caller
+        glDeleteProgram(program);
+        ++cacheStats.rejected;
+        ++cacheStats.misses;
+        return 0;
+    }
+
+    ++cacheStats.hits;
+    std::chrono::duration<double, std::milli> loadTime = Clock::now() - begin;
+    cacheStats.savedMilliseconds +=
+        header.compileMilliseconds - loadTime.count();
+    return program;
+}
+
+void ProgramCache::store(std::uint64_t key, unsigned int program,
+                         double compileMilliseconds) {
+    cacheStats.compileMilliseconds += compileMilliseconds;
+    if (!supported) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    std::vector<char> binary(static_cast<std::size_t>(length));
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.key = key;
+    header.format = format;
+    header.size = static_cast<std::uint32_t>(length);
+    header.compileMilliseconds = compileMilliseconds;
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    // write to a temporary file first, so a crash mid-write can't leave a
+    // truncated binary behind
+    std::string path = pathOf(key);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        stream.write(binary.data(), length);
+        if (!stream) {
+            std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED: " << tempPath
+                      << '\n';
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED: " << path << ": "
+                  << error.message() << '\n';
+        std::filesystem::remove(tempPath, error);
+    }
+}
+
+const ProgramCache::Stats& ProgramCache::stats() const { return cacheStats; }
+
+std::string ProgramCache::pathOf(std::uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.programbinary",
+                  static_cast<unsigned long long>(key));
+    return directory + '/' + name;
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,72 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace personal::renderer::utility {
+
+// where linked programs are cached, relative to the working directory
+const char* const PROGRAM_CACHE_DIRECTORY = "shaders/cache";
+
+// Binary cache of linked shader programs, so a warm start skips compiling
+// and linking. Each program is stored as '<key>.programbinary' in the cache
+// directory, its key a hash of the program's source text and of the driver's
+// vendor, renderer and version strings, so any change to either leads to a
+// new entry instead of a stale binary. A driver may still reject a binary it
+// produced, e.g. after an update that kept its version string; the program
+// is then compiled again and the entry replaced.
+//
+// Needs GL 4.1 and a driver that offers at least one binary format,
+// otherwise every lookup misses and nothing is stored. Has to be used on the
+// thread owning the GL context.
+class ProgramCache {
+   public:
+    struct Stats {
+        std::size_t hits{0};
+        std::size_t misses{0};
+        // binaries the driver refused to load
+        std::size_t rejected{0};
+        // time spent compiling on misses, and the compile time hits saved
+        // minus the time they took to load
+        double compileMilliseconds{0.0};
+        double savedMilliseconds{0.0};
+    };
+
+    static ProgramCache& shared();
+
+    explicit ProgramCache(std::string directory = PROGRAM_CACHE_DIRECTORY);
+
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache& operator=(const ProgramCache&) = delete;
+
+    // whether the driver can save and load program binaries
+    bool enabled() const;
+    // the key of a program built from the given stage sources
+    std::uint64_t key(const std::vector<const std::string*>& sources) const;
+    // creates a linked program from its cached binary, or returns 0 if there
+    // is none or the driver rejects it
+    unsigned int load(std::uint64_t key);
+    // caches a freshly linked program that took compileMilliseconds to
+    // build. It has to have been linked with
+    // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+    void store(std::uint64_t key, unsigned int program,
+               double compileMilliseconds);
+
+    const Stats& stats() const;
+
+   private:
+    std::string directory;
+    bool supported{false};
+    // vendor, renderer and version, hashed into every key
+    std::uint64_t driverHash{0};
+    Stats cacheStats;
+
+    std::string pathOf(std::uint64_t key) const;
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // PROGRAM_CACHE_H
@@ -0,0 +1,215 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace personal::renderer::utility {
+
+namespace {
+
+const unsigned int PASS_BITS = 4;
+const unsigned int PROGRAM_BITS = 12;
+const unsigned int MATERIAL_BITS = 16;
+const unsigned int VERTEX_ARRAY_BITS = 12;
+const unsigned int DEPTH_BITS = 20;
+
+std::uint64_t field(std::uint64_t value, unsigned int bits,
+                    unsigned int shift) {
+    return (value & ((std::uint64_t{1} << bits) - 1)) << shift;
+}
+
+// FNV-1a over everything Mesh::bindMaterial sets, folded to the key width
+std::uint32_t materialKey(const Mesh& mesh) {
+    std::uint32_t hash = 2166136261u;
+    auto mix = [&hash](const void* data, std::size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+    };
+    for (const Texture& texture : mesh.textures)
+        mix(&texture.id, sizeof(texture.id));
+    if (mesh.format == VertexFormat::Packed) {
+        mix(&mesh.quantization.offset[0], sizeof(float) * 3);
+        mix(&mesh.quantization.scale[0], sizeof(float) * 3);
+    }
+    return (hash >> MATERIAL_BITS) ^ (hash & 0xffffu);
+}
+
+bool sameTransform(const glm::mat4& a, const glm::mat4& b) {
+    return std::memcmp(&a[0][0], &b[0][0], sizeof(glm::mat4)) == 0;
+}
+
+}  // namespace
+
+void DrawList::clear() { draws.clear(); }
+
+void DrawList::add(const Mesh& mesh, const Shader& shader,
+                   const glm::mat4& transform, RenderPass pass,
+                   std::size_t instanceCount, std::uint8_t level,
+                   std::size_t baseInstance) {
+    draws.push_back(Draw{&mesh, &shader, transform, pass, instanceCount,
+                         baseInstance, level});
+}
+
+void RenderQueue::begin(const glm::mat4& view, float farPlane,
+                        UniformBuffers* uniforms) {
+    frameView = view;
+    frameFarPlane = farPlane;
+    frameUniforms = uniforms;
+    items.clear();
+    entries.clear();
+}
+
+void RenderQueue::submit(const Mesh& mesh, const Shader& shader,
+                         const glm::mat4& transform, RenderPass pass,
+                         std::size_t instanceCount, std::uint8_t level,
+                         std::size_t baseInstance) {
+    // view space distance of the mesh's bounding sphere centre
+    glm::vec4 center =
+        frameView * transform * glm::vec4(mesh.sphere.center, 1.0f);
+    float depth = std::clamp(-center.z / frameFarPlane, 0.0f, 1.0f);
+    if (pass == RenderPass::Transparent) depth = 1.0f - depth;
+
+    entries.push_back(SortEntry{
+        makeKey(pass, shader.ID, materialKey(mesh), mesh.VAO, depth),
+        static_cast<std::uint32_t>(items.size())});
+    items.push_back(Item{&mesh, &shader, transform,
+                         shader.modelUniform().location,
+                         frameUniforms && shader.hasDrawBlock(),
+                         instanceCount, baseInstance, level});
+}
+
+void RenderQueue::submit(const DrawList& list) {
+    for (const DrawList::Draw& draw : list.draws)
+        submit(*draw.mesh, *draw.shader, draw.transform, draw.pass,
+               draw.instanceCount, draw.level, draw.baseInstance);
+}
+
+void RenderQueue::execute() {
+    frameStats = Stats{};
+    frameStats.items = items.size();
+    for (const Item& item : items)
+        frameStats.triangles += item.mesh->lod(item.level).indexCount / 3 *
+                                std::max<std::size_t>(item.instanceCount, 1);
+    // whatever ran since the last frame may have changed any binding
+    state.reset();
+    state.resetStats();
+
+    sortEntries();
+    if (frameUniforms) writeDrawUniforms();
+
+    const Item* previous = nullptr;
+    std::size_t i = 0;
+    while (i < entries.size()) {
+        const Item& item = items[entries[i].item];
+        state.useProgram(item.shader->ID);
+        if (item.drawBlock)
+            frameUniforms->bindDraw(drawOffsets[i]);
+        else if (item.transformLocation != -1 &&
+                 !(previous && previous->shader == item.shader &&
+                   sameTransform(previous->transform, item.transform)))
+            glUniformMatrix4fv(item.transformLocation, 1, GL_FALSE,
+                               &item.transform[0][0]);
+
+        if (item.instanceCount > 0) {
+            item.mesh->drawInstanced(*item.shader, item.instanceCount,
+                                     &state, item.level, item.baseInstance);
+            ++frameStats.drawCalls;
+            previous = &item;
+            ++i;
+            continue;
+        }
+
+        // merge the following draws that only differ by their range of a
+        // shared vertex array
+        batch.clear();
+        batchLevels.clear();
+        batch.push_back(item.mesh);
+        batchLevels.push_back(item.level);
+        std::size_t next = i + 1;
+        for (; next < entries.size(); ++next) {
+            const Item& candidate = items[entries[next].item];
+            if (candidate.instanceCount > 0 ||
+                candidate.shader != item.shader ||
+                !sameTransform(candidate.transform, item.transform) ||
+                !item.mesh->canBatchWith(*candidate.mesh))
+                break;
+            batch.push_back(candidate.mesh);
+            batchLevels.push_back(candidate.level);
+        }
+        Mesh::drawMulti(*item.shader, batch, &state, &batchLevels);
+        ++frameStats.drawCalls;
+        previous = &items[entries[next - 1].item];
+        i = next;
+    }
+
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+    frameStats.state = state.stats();
+}
+
+std::size_t RenderQueue::size() const { return items.size(); }
+
+const RenderQueue::Stats& RenderQueue::stats() const { return frameStats; }
+
+std::uint64_t RenderQueue::makeKey(RenderPass pass, unsigned int program,
+                                   std::uint32_t material,
+                                   unsigned int vertexArray, float depth) {
+    const std::uint64_t depthMax = (std::uint64_t{1} << DEPTH_BITS) - 1;
+    std::uint64_t quantizedDepth = static_cast<std::uint64_t>(
+        std::clamp(depth, 0.0f, 1.0f) * static_cast<float>(depthMax));
+
+    unsigned int shift = DEPTH_BITS;
+    std::uint64_t key = field(quantizedDepth, DEPTH_BITS, 0);
+    key |= field(vertexArray, VERTEX_ARRAY_BITS, shift);
+    shift += VERTEX_ARRAY_BITS;
+    key |= field(material, MATERIAL_BITS, shift);
+    shift += MATERIAL_BITS;
+    key |= field(program, PROGRAM_BITS, shift);
+    shift += PROGRAM_BITS;
+    key |= field(static_cast<std::uint64_t>(pass), PASS_BITS, shift);
+    return key;
+}
+
+void RenderQueue::writeDrawUniforms() {
+    drawOffsets.resize(entries.size());
+    frameUniforms->reserveDraws(entries.size());
+    const Item* previous = nullptr;
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        const Item& item = items[entries[i].item];
+        if (!item.drawBlock) continue;
+        if (!previous || !sameTransform(previous->transform, item.transform))
+            offset = frameUniforms->pushDraw(DrawUniforms(item.transform));
+        drawOffsets[i] = offset;
+        previous = &item;
+    }
+    frameUniforms->flush();
+}
+
+void RenderQueue::sortEntries() {
+    scratch.resize(entries.size());
+    for (unsigned int shift = 0; shift < 64; shift += 8) {
+        std::size_t counts[256] = {};
+        for (const SortEntry& entry : entries)
+            ++counts[(entry.key >> shift) & 0xff];
+        // every key has the same byte here, nothing to reorder
+        std::size_t firstByte =
+            entries.empty() ? 0 : (entries[0].key >> shift) & 0xff;
+        if (counts[firstByte] == entries.size()) continue;
+
+        std::size_t offset = 0;
+        for (std::size_t& count : counts) {
+            std::size_t bucket = count;
+            count = offset;
+            offset += bucket;
+        }
+        for (const SortEntry& entry : entries)
+            scratch[counts[(entry.key >> shift) & 0xff]++] = entry;
+        entries.swap(scratch);
+    }
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,135 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "gl_state.h"
+#include "mesh.h"
+#include "shader.h"
+#include "uniform_buffers.h"
+
+namespace personal::renderer::utility {
+
+// Passes are drawn in this order. Opaque draws are sorted front to back to
+// help early depth rejection, transparent ones back to front.
+enum class RenderPass : std::uint8_t { Opaque, Transparent };
+
+// Draws recorded without touching GL or a queue, so that jobs can each
+// record a list of their own off the GL thread. RenderQueue::submit() then
+// queues a list's draws in the order they were recorded.
+struct DrawList {
+    struct Draw {
+        const Mesh* mesh;
+        const Shader* shader;
+        glm::mat4 transform;
+        RenderPass pass;
+        std::size_t instanceCount;
+        std::size_t baseInstance;
+        std::uint8_t level;
+    };
+
+    std::vector<Draw> draws;
+
+    void clear();
+    // takes the same arguments as RenderQueue::submit()
+    void add(const Mesh& mesh, const Shader& shader,
+             const glm::mat4& transform, RenderPass pass = RenderPass::Opaque,
+             std::size_t instanceCount = 0, std::uint8_t level = 0,
+             std::size_t baseInstance = 0);
+};
+
+// Collects a frame's draws and submits them sorted by state, so that draws
+// sharing a program, material and vertex array end up next to each other. The
+// 64-bit sort key is, from the most significant bit down:
+//
+//   pass (4) | program (12) | material (16) | vertex array (12) | depth (20)
+//
+// Programs and vertex arrays are keyed by their GL names and materials by a
+// hash of their textures, so a collision only costs some sorting quality.
+// Binding goes through a GLStateTracker that skips redundant calls, and runs
+// of compatible meshes are merged into multi-draw calls.
+//
+// Per-frame uniforms like view and projection are left to the caller; the
+// queue only sets each draw's model matrix. Programs with a 'draw' uniform
+// block get theirs as DrawUniforms, all written to the UniformBuffers in one
+// go before drawing and bound by range; others get their 'model' uniform
+// set, when they have one.
+class RenderQueue {
+   public:
+    struct Stats {
+        std::size_t items{0};
+        std::size_t drawCalls{0};
+        // including every instance
+        std::size_t triangles{0};
+        GLStateTracker::Stats state;
+    };
+
+    // starts a frame, dropping anything still queued. The view matrix and far
+    // plane distance are used for the depth part of the keys. Draw uniform
+    // blocks go to the given buffers, whose frame has to have begun.
+    void begin(const glm::mat4& view, float farPlane,
+               UniformBuffers* uniforms = nullptr);
+    // queues a mesh at the given level of detail. With an instanceCount of 0
+    // it is drawn without instancing at the given transform, otherwise the
+    // instances from baseInstance on are drawn.
+    void submit(const Mesh& mesh, const Shader& shader,
+                const glm::mat4& transform,
+                RenderPass pass = RenderPass::Opaque,
+                std::size_t instanceCount = 0, std::uint8_t level = 0,
+                std::size_t baseInstance = 0);
+    // queues every draw of a list
+    void submit(const DrawList& list);
+    // sorts the queued draws and draws them. Leaves no VAO bound and texture
+    // unit 0 active afterwards.
+    void execute();
+
+    std::size_t size() const;
+    // counts of the last execute()
+    const Stats& stats() const;
+
+    static std::uint64_t makeKey(RenderPass pass, unsigned int program,
+                                 std::uint32_t material,
+                                 unsigned int vertexArray, float depth);
+
+   private:
+    struct Item {
+        const Mesh* mesh;
+        const Shader* shader;
+        glm::mat4 transform;
+        int transformLocation;
+        bool drawBlock;
+        std::size_t instanceCount;
+        std::size_t baseInstance;
+        std::uint8_t level;
+    };
+    struct SortEntry {
+        std::uint64_t key;
+        std::uint32_t item;
+    };
+
+    glm::mat4 frameView{1.0f};
+    float frameFarPlane{1.0f};
+    UniformBuffers* frameUniforms{nullptr};
+    std::vector<Item> items;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+    // offset of each sorted entry's draw block
+    std::vector<std::size_t> drawOffsets;
+    std::vector<const Mesh*> batch;
+    std::vector<std::uint8_t> batchLevels;
+    GLStateTracker state;
+    Stats frameStats;
+
+    // LSD radix sort of entries by key, one byte per pass
+    void sortEntries();
+    // writes the draw blocks of the sorted entries, sharing one between
+    // consecutive entries with the same transform
+    void writeDrawUniforms();
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // RENDER_QUEUE_H
@@ -0,0 +1,249 @@
+#include "scene.h"
+
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+
+#include "job_system.h"
+#include "lod_selector.h"
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// scatters count rock transforms in a ring of the given radius around the
+// origin. Seeded, so the belt looks the same on every run.
+std::vector<glm::mat4> generateAsteroidBelt(std::size_t count, float radius,
+                                            float offset) {
+    std::mt19937 random(1337);
+    std::uniform_real_distribution<float> displacement(-offset, offset);
+    std::uniform_real_distribution<float> scale(0.05f, 0.25f);
+    std::uniform_real_distribution<float> rotation(0.0f, 360.0f);
+
+    std::vector<glm::mat4> transforms(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        // displace along a circle of the given radius, flatten the height
+        float angle =
+            static_cast<float>(i) / static_cast<float>(count) * 360.0f;
+        float x = std::sin(glm::radians(angle)) * radius + displacement(random);
+        float y = displacement(random) * 0.4f;
+        float z = std::cos(glm::radians(angle)) * radius + displacement(random);
+
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, y, z));
+        model = glm::scale(model, glm::vec3(scale(random)));
+        model = glm::rotate(model, glm::radians(rotation(random)),
+                            glm::vec3(0.4f, 0.6f, 0.8f));
+        transforms[i] = model;
+    }
+    return transforms;
+}
+
+struct SceneDescription {
+    const char* name;
+    std::size_t rockCount;
+};
+
+const SceneDescription SCENES[] = {
+    {"asteroids", 100000}, {"asteroids-small", 10000}, {"planet", 0}};
+
+}  // namespace
+
+// the programs are all submitted before any of them is waited for, so the
+// driver can build them side by side while the models start loading. They
+// are set up once linked, see setUpPrograms().
+Scene::Scene(std::size_t rockCount)
+    : asteroidShader("shaders/asteroid.vert", "shaders/asteroid.frag",
+                     nullptr, ShaderBuild::Deferred),
+      planetShader("shaders/planet.vert", "shaders/planet.frag", nullptr,
+                   ShaderBuild::Deferred),
+      singleColour("shaders/packed.vert", "shaders/single_colour.frag",
+                   nullptr, ShaderBuild::Deferred),
+      rockCount(rockCount) {
+    if (InstancedModel::indirectSupported()) {
+        instanceCulling = std::make_unique<Shader>(Shader::compute(
+            "shaders/cull_instances.comp", ShaderBuild::Deferred));
+        gpuCulling = true;
+    }
+    // the planet first, since it's the largest thing on screen
+    planet = streamer.load("res/models/planet/planet.obj", false,
+                           {VertexFormat::Standard, true, false, true,
+                            &staticGeometry});
+    cube = streamer.load("res/models/cube/cube.obj", false,
+                         {VertexFormat::Packed, true, false, false,
+                          &staticGeometry});
+    if (rockCount > 0)
+        rock = streamer.load("res/models/rock/rock.obj", false,
+                             {VertexFormat::Standard, true, false, true});
+}
+
+std::unique_ptr<Scene> Scene::load(const std::string& name) {
+    for (const SceneDescription& scene : SCENES)
+        if (name == scene.name) return std::make_unique<Scene>(scene.rockCount);
+
+    std::cout << "ERROR::SCENE::UNKNOWN_SCENE: " << name << '\n';
+    return nullptr;
+}
+
+std::vector<std::string> Scene::names() {
+    std::vector<std::string> result;
+    for (const SceneDescription& scene : SCENES) result.push_back(scene.name);
+    return result;
+}
+
+bool Scene::loaded() const { return streamer.idle(); }
+
+void Scene::finishLoading() {
+    streamer.finish();
+    createAsteroids();
+}
+
+void Scene::render(const glm::mat4& view, const glm::mat4& projection,
+                   float viewportHeight, Profiler& profiler) {
+    {
+        ProfileScope scope(profiler, "Stream");
+        streamer.update();
+        createAsteroids();
+    }
+    // nothing is drawn until a model is resident, so until then the
+    // programs only need to be polled
+    if (!setUpPrograms(cube.get() || planet.get() || asteroids)) return;
+
+    uniforms.beginFrame(FrameUniforms{projection, view});
+
+    glm::mat4 cubeTransform =
+        glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 145.0f));
+    glm::mat4 planetTransform =
+        glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -3.0f, 0.0f));
+    planetTransform = glm::scale(planetTransform, glm::vec3(4.0f));
+
+    // only submit what the camera can see. Models are tested in their own
+    // object space, the asteroid instances in world space. Each model is
+    // culled by a job of its own, into its own draw list and stats, and the
+    // asteroid belt splits its instances into further jobs.
+    glm::mat4 viewProjection = projection * view;
+    LodSelector lod(view, projection, viewportHeight, lodPixelError);
+    bool cullOnGpu = gpuCulling && instanceCulling;
+    AssimpModel* cubeModel = cube.get();
+    AssimpModel* planetModel = planet.get();
+    cubeDraws.clear();
+    planetDraws.clear();
+    for (CullingStats& stats : jobCulling) stats.reset();
+    {
+        ProfileScope scope(profiler, "Cull and record");
+        JobSystem& jobs = JobSystem::shared();
+        JobSystem::Counter recorded;
+        // models that aren't resident yet are skipped
+        if (cubeModel)
+            jobs.run(
+                [&]() {
+                    cubeModel->record(
+                        cubeDraws, singleColour, cubeTransform,
+                        Frustum::fromMatrix(viewProjection * cubeTransform),
+                        jobCulling[0], &lod);
+                },
+                recorded);
+        if (planetModel)
+            jobs.run(
+                [&]() {
+                    planetModel->record(
+                        planetDraws, planetShader, planetTransform,
+                        Frustum::fromMatrix(viewProjection * planetTransform),
+                        jobCulling[1], &lod);
+                },
+                recorded);
+        if (asteroids && !cullOnGpu)
+            jobs.run(
+                [&]() {
+                    asteroids->prepare(Frustum::fromMatrix(viewProjection),
+                                       jobCulling[2], &lod);
+                },
+                recorded);
+        jobs.wait(recorded);
+    }
+
+    {
+        // only the GL thread touches the queue and the instance buffer
+        ProfileScope scope(profiler, "Submit");
+        renderQueue.begin(view, SCENE_FAR_PLANE, &uniforms);
+        renderQueue.submit(cubeDraws);
+        renderQueue.submit(planetDraws);
+        if (asteroids && !cullOnGpu)
+            asteroids->submitPrepared(renderQueue, asteroidShader);
+    }
+    {
+        ProfileScope scope(profiler, "Execute queue");
+        renderQueue.execute();
+    }
+    if (asteroids && cullOnGpu) {
+        // a dispatch and a draw call per mesh, however many rocks there are
+        ProfileScope scope(profiler, "Indirect draw");
+        asteroidShader.use();
+        asteroids->drawIndirect(asteroidShader, *instanceCulling,
+                                Frustum::fromMatrix(viewProjection),
+                                jobCulling[2], &lod);
+    }
+    uniforms.endFrame();
+
+    frameDraws = renderQueue.stats();
+    if (asteroids && cullOnGpu) {
+        frameDraws.drawCalls += asteroids->indirectStats().drawCalls;
+        frameDraws.triangles += asteroids->indirectStats().triangles;
+    }
+    culling.reset();
+    for (const CullingStats& stats : jobCulling) {
+        culling.tested += stats.tested;
+        culling.visible += stats.visible;
+        culling.promoted += stats.promoted;
+    }
+}
+
+const CullingStats& Scene::cullingStats() const { return culling; }
+
+const RenderQueue::Stats& Scene::queueStats() const {
+    return renderQueue.stats();
+}
+
+const RenderQueue::Stats& Scene::drawStats() const { return frameDraws; }
+
+const GeometryArena& Scene::geometry() const { return staticGeometry; }
+
+const AssetStreamer::Stats& Scene::streamingStats() const {
+    return streamer.stats();
+}
+
+const UniformBuffers::Stats& Scene::uniformStats() const {
+    return uniforms.stats();
+}
+
+bool Scene::setUpPrograms(bool needed) {
+    if (programsSetUp) return true;
+    Shader* programs[] = {&singleColour, &planetShader, &asteroidShader,
+                          instanceCulling.get()};
+    if (!needed)
+        for (Shader* program : programs)
+            if (program && !program->ready()) return false;
+
+    // resolves whatever is still linking
+    singleColour.use();
+    singleColour.setVec3("colour", glm::vec3(0.0f, 1.0f, 0.0f));
+
+    for (Shader* shader : {&singleColour, &planetShader, &asteroidShader})
+        shader->setUniformBlockBinding("matrices", FRAME_UNIFORM_BINDING);
+    for (Shader* shader : {&singleColour, &planetShader})
+        shader->setUniformBlockBinding("draw", DRAW_UNIFORM_BINDING);
+    if (instanceCulling) instanceCulling->resolve();
+    programsSetUp = true;
+    return true;
+}
+
+void Scene::createAsteroids() {
+    AssimpModel* model = rock.get();
+    if (asteroids || !model) return;
+
+    // asteroid belt: every rock is drawn by a single instanced draw call
+    asteroids = std::make_unique<InstancedModel>(*model, rockCount);
+    asteroids->setInstances(generateAsteroidBelt(rockCount, 150.0f, 25.0f));
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,112 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asset_streamer.h"
+#include "culling.h"
+#include "geometry_arena.h"
+#include "instanced_model.h"
+#include "model.h"
+#include "profiler.h"
+#include "render_queue.h"
+#include "shader.h"
+#include "uniform_buffers.h"
+
+namespace personal::renderer::utility {
+
+const float SCENE_FAR_PLANE = 1000.0f;
+
+// The demo scene: a planet inside a belt of instanced asteroids, with the
+// packed test cube in front of the start position. Shared by the interactive
+// app and the headless benchmark so both measure the same thing. Paths are
+// relative to the repository root.
+//
+// The models stream in: each is drawn from the first frame it's resident.
+class Scene {
+   public:
+    // where the camera starts out
+    glm::vec3 startPosition{0.0f, 0.0f, 155.0f};
+    // how many pixels a level of detail may deviate from the full mesh on
+    // screen; 0 draws everything at full detail
+    float lodPixelError{1.0f};
+    // cull the asteroids and select their levels on the GPU and draw them
+    // indirectly (see InstancedModel::drawIndirect()) rather than through
+    // the job system and the render queue. Only has an effect with GL 4.3,
+    // where it starts out on.
+    bool gpuCulling{false};
+
+    explicit Scene(std::size_t rockCount);
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // "asteroids" (100000 rocks), "asteroids-small" (10000) or "planet" (no
+    // belt). Returns nullptr for anything else.
+    static std::unique_ptr<Scene> load(const std::string& name);
+    static std::vector<std::string> names();
+
+    // uploads what finished loading, then culls, queues and draws everything
+    // resident into the bound framebuffer, which is viewportHeight pixels
+    // tall
+    void render(const glm::mat4& view, const glm::mat4& projection,
+                float viewportHeight, Profiler& profiler);
+
+    // whether every model is resident
+    bool loaded() const;
+    // blocks until every model is resident
+    void finishLoading();
+
+    // counts of the last render()
+    const CullingStats& cullingStats() const;
+    const RenderQueue::Stats& queueStats() const;
+    // the queue's draw calls and triangles plus those of the asteroids' GPU
+    // culled draws, so both culling paths count the same work
+    const RenderQueue::Stats& drawStats() const;
+    const GeometryArena& geometry() const;
+    const AssetStreamer::Stats& streamingStats() const;
+    const UniformBuffers::Stats& uniformStats() const;
+
+   private:
+    // static models share their vertex and index buffers; the rock keeps its
+    // own since it is drawn instanced
+    GeometryArena staticGeometry;
+    Shader asteroidShader;
+    Shader planetShader;
+    Shader singleColour;
+    // shaders/cull_instances.comp, only with GL 4.3
+    std::unique_ptr<Shader> instanceCulling;
+    bool programsSetUp{false};
+    AssetStreamer streamer;
+    ModelHandle rock;
+    ModelHandle planet;
+    ModelHandle cube;
+    // created once the rock is resident
+    std::unique_ptr<InstancedModel> asteroids;
+    std::size_t rockCount;
+    // the models' draws, recorded by jobs and replayed into the queue
+    DrawList cubeDraws;
+    DrawList planetDraws;
+    // draws are queued and submitted sorted by state
+    RenderQueue renderQueue;
+    // view and projection for every shader, and the queue's model matrices
+    UniformBuffers uniforms;
+    CullingStats culling;
+    RenderQueue::Stats frameDraws;
+    // the cube's, the planet's and the asteroids' share of it
+    CullingStats jobCulling[3];
+
+    // sets the programs' uniforms and block bindings once, when they have
+    // all linked or, if needed, right away, waiting for them. Returns
+    // whether they are set up.
+    bool setUpPrograms(bool needed);
+    void createAsteroids();
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // SCENE_H
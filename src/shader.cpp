@@ -1,141 +1,429 @@
 #include "shader.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "gl_state.h"
+#include "program_cache.h"
+
 namespace personal::renderer::utility {
 
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// from GL_KHR_parallel_shader_compile, the same as the ARB version
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+std::atomic<std::uint64_t> lookupsAvoided{0};
+
+// reads a whole source file in one go, or returns an empty string if it
+// can't be read
+std::string readSource(const char* path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    std::streamoff size =
+        file ? static_cast<std::streamoff>(file.tellg()) : -1;
+    if (size < 0) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path
+                  << std::endl;
+        return {};
+    }
+    std::string source(static_cast<std::size_t>(size), '\0');
+    file.seekg(0);
+    file.read(source.data(), static_cast<std::streamsize>(size));
+    if (!file) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path
+                  << std::endl;
+        return {};
+    }
+    return source;
+}
+
+// submits a shader's compile without waiting for it
+unsigned int compileStage(GLenum type, const std::string& source) {
+    const char* code = source.c_str();
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &code, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+// the stage a shader is for, as printed in compile errors
+const char* stageName(unsigned int shader) {
+    GLint type = 0;
+    glGetShaderiv(shader, GL_SHADER_TYPE, &type);
+    switch (type) {
+        case GL_VERTEX_SHADER:
+            return "VERTEX";
+        case GL_FRAGMENT_SHADER:
+            return "FRAGMENT";
+        case GL_GEOMETRY_SHADER:
+            return "GEOMETRY";
+        case GL_COMPUTE_SHADER:
+            return "COMPUTE";
+    }
+    return "UNKNOWN";
+}
+
+// whether a uniform of this type is bound to a texture unit
+bool isSampler(GLenum type) {
+    switch (type) {
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_1D_SHADOW:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_1D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_2D_ARRAY_SHADOW:
+        case GL_SAMPLER_CUBE_SHADOW:
+        case GL_SAMPLER_2D_MULTISAMPLE:
+        case GL_SAMPLER_2D_RECT:
+        case GL_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+            return true;
+    }
+    return false;
+}
+
+// whether the driver compiles in the background and can be polled for it
+bool parallelCompile() {
+    static const bool supported =
+        hasExtension("GL_KHR_parallel_shader_compile") ||
+        hasExtension("GL_ARB_parallel_shader_compile");
+    return supported;
+}
+
+}  // namespace
+
 Shader::Shader(const char* vertexPath, const char* fragmentPath,
-               const char* geometryPath) {
+               const char* geometryPath, ShaderBuild build) {
     // 1. retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
+    std::string vertexCode = readSource(vertexPath);
+    std::string fragmentCode = readSource(fragmentPath);
     std::string geometryCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-    std::ifstream gShaderFile;
-    // ensure ifstream objects can throw exceptions:
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-        // convert stream into string
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-        // if geometry shader path is present, also load a geometry shader
-        if (geometryPath != nullptr) {
-            gShaderFile.open(geometryPath);
-            std::stringstream gShaderStream;
-            gShaderStream << gShaderFile.rdbuf();
-            gShaderFile.close();
-            geometryCode = gShaderStream.str();
-        }
-    } catch (std::ifstream::failure& e) {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what()
-                  << std::endl;
-    }
-    const char* vShaderCode = vertexCode.c_str();
-    const char* fShaderCode = fragmentCode.c_str();
-    // 2. compile shaders
-    unsigned int vertex, fragment;
-    // vertex shader
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
-    // fragment Shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
-    // if geometry shader is given, compile geometry shader
-    unsigned int geometry{};
-    if (geometryPath != nullptr) {
-        const char* gShaderCode = geometryCode.c_str();
-        geometry = glCreateShader(GL_GEOMETRY_SHADER);
-        glShaderSource(geometry, 1, &gShaderCode, NULL);
-        glCompileShader(geometry);
-        checkCompileErrors(geometry, "GEOMETRY");
+    // if geometry shader path is present, also load a geometry shader
+    if (geometryPath != nullptr) geometryCode = readSource(geometryPath);
+
+    std::vector<std::pair<GLenum, const std::string*>> sources = {
+        {GL_VERTEX_SHADER, &vertexCode}, {GL_FRAGMENT_SHADER, &fragmentCode}};
+    if (geometryPath != nullptr)
+        sources.emplace_back(GL_GEOMETRY_SHADER, &geometryCode);
+    create(sources, build);
+}
+
+Shader Shader::compute(const char* computePath, ShaderBuild build) {
+    std::string computeCode = readSource(computePath);
+    Shader shader;
+    shader.create({{GL_COMPUTE_SHADER, &computeCode}}, build);
+    return shader;
+}
+
+void Shader::create(
+    const std::vector<std::pair<GLenum, const std::string*>>& sources,
+    ShaderBuild build) {
+    // 2. reuse the program linked on an earlier run if the sources and the
+    // driver are still the same. A compute shader's key differs from any
+    // other program's by the number of sources.
+    ProgramCache& cache = ProgramCache::shared();
+    std::vector<const std::string*> keySources(3, nullptr);
+    if (sources.front().first == GL_COMPUTE_SHADER) keySources.resize(1);
+    for (std::size_t i = 0; i < sources.size(); ++i)
+        keySources[i] = sources[i].second;
+    cacheKey = cache.key(keySources);
+    ID = cache.load(cacheKey);
+    if (ID) {
+        reflectUniforms();
+        return;
     }
+
+    // 3. submit the compiles and the link. Their status is only checked in
+    // resolve(), since asking for it waits for the driver.
+    buildBegin = Clock::now();
+    for (std::size_t i = 0; i < sources.size(); ++i)
+        stages[i] = compileStage(sources[i].first, *sources[i].second);
     // shader Program
     ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    if (geometryPath != nullptr) glAttachShader(ID, geometry);
+    for (unsigned int stage : stages)
+        if (stage) glAttachShader(ID, stage);
+    if (cache.enabled())
+        glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(ID);
+    linking = true;
+
+    if (build == ShaderBuild::Blocking) resolve();
+}
+
+void Shader::use() {
+    resolve();
+    glUseProgram(ID);
+}
+
+bool Shader::ready() const {
+    if (!linking || !parallelCompile()) return true;
+    GLint complete = GL_FALSE;
+    glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+void Shader::resolve() const {
+    if (!linking) return;
+    linking = false;
+
+    for (unsigned int stage : stages)
+        if (stage) checkCompileErrors(stage, stageName(stage));
     checkCompileErrors(ID, "PROGRAM");
+    GLint linked = GL_FALSE;
+    glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+    if (linked) {
+        std::chrono::duration<double, std::milli> buildTime =
+            Clock::now() - buildBegin;
+        ProgramCache::shared().store(cacheKey, ID, buildTime.count());
+    }
+    reflectUniforms();
     // delete the shaders as they're linked into our program now and no longer
     // necessary
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-    if (geometryPath != nullptr) glDeleteShader(geometry);
+    for (unsigned int& stage : stages) {
+        if (stage) glDeleteShader(stage);
+        stage = 0;
+    }
 }
 
-void Shader::use() { glUseProgram(ID); }
-
 void Shader::setUniformBlockBinding(const std::string& name,
                                     unsigned int bindIndex) const {
+    resolve();
     glUniformBlockBinding(ID, glGetUniformBlockIndex(ID, name.c_str()),
                           bindIndex);
 }
 
+bool Shader::hasUniformBlock(const std::string& name) const {
+    resolve();
+    return std::find(uniformBlocks.begin(), uniformBlocks.end(), name) !=
+           uniformBlocks.end();
+}
+
+Uniform<glm::mat4> Shader::modelUniform() const {
+    resolve();
+    return modelMatrix;
+}
+
+bool Shader::hasDrawBlock() const {
+    resolve();
+    return drawBlock;
+}
+
 void Shader::setBool(const std::string& name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(uniformLocation(name), (int)value);
 }
 
 void Shader::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(uniformLocation(name), value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(uniformLocation(name), value);
 }
 
 void Shader::setVec2(const std::string& name, const glm::vec2& value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform2fv(uniformLocation(name), 1, &value[0]);
 }
 void Shader::setVec2(const std::string& name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    glUniform2f(uniformLocation(name), x, y);
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(uniformLocation(name), 1, &value[0]);
 }
 void Shader::setVec3(const std::string& name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    glUniform3f(uniformLocation(name), x, y, z);
 }
 
 void Shader::setVec4(const std::string& name, const glm::vec4& value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform4fv(uniformLocation(name), 1, &value[0]);
 }
 void Shader::setVec4(const std::string& name, float x, float y, float z,
                      float w) const {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    glUniform4f(uniformLocation(name), x, y, z, w);
 }
 
 void Shader::setMat2(const std::string& name, const glm::mat2& mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
+    glUniformMatrix2fv(uniformLocation(name), 1, GL_FALSE,
                        &mat[0][0]);
 }
 
 void Shader::setMat3(const std::string& name, const glm::mat3& mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
+    glUniformMatrix3fv(uniformLocation(name), 1, GL_FALSE,
                        &mat[0][0]);
 }
 
 void Shader::setMat4(const std::string& name, const glm::mat4& mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
+    glUniformMatrix4fv(uniformLocation(name), 1, GL_FALSE,
                        &mat[0][0]);
 }
 
-void Shader::checkCompileErrors(unsigned int shader, std::string type) {
+int Shader::uniformLocation(const std::string& name) const {
+    bool listed = false;
+    int location = findLocation(name, listed);
+    if (listed && location >= 0) ++lookupsAvoided;
+    return location;
+}
+
+int Shader::findLocation(const std::string& name, bool& listed) const {
+    resolve();
+    auto it = std::lower_bound(
+        uniforms.begin(), uniforms.end(), name,
+        [](const UniformEntry& entry, const std::string& value) {
+            return entry.name < value;
+        });
+    listed = it != uniforms.end() && it->name == name;
+    if (listed) return it->location;
+
+    // struct array elements past the first, or names that don't exist.
+    // Either way the driver is only asked once.
+    int location = glGetUniformLocation(ID, name.c_str());
+    uniforms.insert(it, {name, location});
+    return location;
+}
+
+void Shader::set(Uniform<bool> uniform, bool value) const {
+    if (uniform.location >= 0) ++lookupsAvoided;
+    glUniform1i(uniform.location, (int)value);
+}
+
+void Shader::set(Uniform<int> uniform, int value) const {
+    if (uniform.location >= 0) ++lookupsAvoided;
+    glUniform1i(uniform.location, value);
+}
+
+void Shader::set(Uniform<float> uniform, float value) const {
+    if (uniform.location >= 0) ++lookupsAvoided;
+    glUniform1f(uniform.location, value);
+}
+
+void Shader::set(Uniform<glm::vec2> uniform, const glm::vec2& value) const {
+    if (uniform.location >= 0) ++lookupsAvoided;
+    glUniform2fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3& value) const {
+    if (uniform.location >= 0) ++lookupsAvoided;
+    glUniform3fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::set(Uniform<glm::vec4> uniform, const glm::vec4& value) const {
+    if (uniform.location >= 0) ++lookupsAvoided;
+    glUniform4fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::set(Uniform<glm::mat2> uniform, const glm::mat2& mat) const {
+    if (uniform.location >= 0) ++lookupsAvoided;
+    glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::set(Uniform<glm::mat3> uniform, const glm::mat3& mat) const {
+    if (uniform.location >= 0) ++lookupsAvoided;
+    glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const {
+    if (uniform.location >= 0) ++lookupsAvoided;
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+
+std::uint64_t Shader::locationLookupsAvoided() { return lookupsAvoided; }
+
+void Shader::reflectUniforms() const {
+    uniforms.clear();
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<char> buffer(static_cast<std::size_t>(std::max(maxLength, 1)));
+    // samplers and their units, handed out in the order they're reported
+    std::vector<std::pair<GLint, std::vector<GLint>>> samplers;
+    GLint nextUnit = 0;
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, static_cast<GLuint>(i), maxLength, &length,
+                           &size, &type, buffer.data());
+        std::string name(buffer.data(), static_cast<std::size_t>(length));
+
+        // members of uniform blocks have no location of their own
+        GLint location = glGetUniformLocation(ID, name.c_str());
+        if (location < 0) continue;
+
+        if (isSampler(type)) {
+            std::vector<GLint> units(static_cast<std::size_t>(size));
+            for (GLint& unit : units) unit = nextUnit++;
+            samplers.emplace_back(location, std::move(units));
+        }
+
+        // arrays are reported as 'name[0]'. Register the bare name as well as
+        // every element, so all the ways of addressing them resolve. Arrays
+        // of structs are reported member by member ('lights[0].position'),
+        // under their full names; uniformLocation() asks the driver for any
+        // element that isn't listed.
+        const std::string FIRST_ELEMENT = "[0]";
+        if (name.size() <= FIRST_ELEMENT.size() ||
+            name.compare(name.size() - FIRST_ELEMENT.size(),
+                         FIRST_ELEMENT.size(), FIRST_ELEMENT) != 0) {
+            uniforms.push_back({name, location});
+            continue;
+        }
+        std::string base = name.substr(0, name.size() - FIRST_ELEMENT.size());
+        uniforms.push_back({base, location});
+        for (GLint element = 0; element < size; ++element) {
+            std::string elementName =
+                base + '[' + std::to_string(element) + ']';
+            uniforms.push_back(
+                {elementName, glGetUniformLocation(ID, elementName.c_str())});
+        }
+    }
+
+    std::sort(uniforms.begin(), uniforms.end(),
+              [](const UniformEntry& a, const UniformEntry& b) {
+                  return a.name < b.name;
+              });
+
+    // the samplers keep their units for good, so drawing only binds textures
+    if (!samplers.empty()) {
+        GLint previous = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+        glUseProgram(ID);
+        for (const auto& [location, units] : samplers)
+            glUniform1iv(location, static_cast<GLsizei>(units.size()),
+                         units.data());
+        glUseProgram(static_cast<GLuint>(previous));
+    }
+    bool listed = false;
+    modelMatrix = Uniform<glm::mat4>{findLocation("model", listed)};
+
+    uniformBlocks.clear();
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    buffer.resize(static_cast<std::size_t>(std::max(maxLength, 1)));
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(ID, static_cast<GLuint>(i), maxLength,
+                                    &length, buffer.data());
+        uniformBlocks.emplace_back(buffer.data(),
+                                   static_cast<std::size_t>(length));
+    }
+    drawBlock = std::find(uniformBlocks.begin(), uniformBlocks.end(),
+                          "draw") != uniformBlocks.end();
+}
+
+void Shader::checkCompileErrors(unsigned int shader,
+                                std::string type) const {
     int success;
     char infoLog[1024];
     if (type != "PROGRAM") {
@@ -3,28 +3,67 @@
 
 #include <glad/glad.h>
 
+#include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace personal::renderer::utility {
 
+// A uniform location resolved ahead of time, typed by the value it accepts.
+// Fetch once with Shader::uniform<T>() outside the render loop and pass it to
+// Shader::set() in the loop to skip the name lookup entirely.
+template <typename T>
+struct Uniform {
+    int location{-1};
+};
+
+// How a Shader's constructor builds its program. Blocking waits for the
+// link and checks it before returning. Deferred only submits the compiles
+// and the link, so the driver can work on several programs at once; see
+// Shader::ready().
+enum class ShaderBuild { Blocking, Deferred };
+
 class Shader {
    public:
     unsigned int ID;
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath,
-           const char* geometryPath = nullptr);
+           const char* geometryPath = nullptr,
+           ShaderBuild build = ShaderBuild::Blocking);
+    // a compute program, which needs GL 4.3
+    static Shader compute(const char* computePath,
+                          ShaderBuild build = ShaderBuild::Blocking);
 
     // activate the shader
     // ------------------------------------------------------------------------
     void use();
 
+    // whether a deferred program has finished linking, polled without
+    // blocking. Drivers without GL_KHR_parallel_shader_compile or
+    // GL_ARB_parallel_shader_compile can't be polled and are always ready.
+    bool ready() const;
+    // waits for a deferred program, reports its compile and link errors and
+    // reads its uniforms. Everything that needs the linked program calls it
+    // first, so deferred programs resolve on first use.
+    void resolve() const;
+
     void setUniformBlockBinding(const std::string& name,
                                 unsigned int bindIndex) const;
+    // whether the program has an active uniform block of this name
+    bool hasUniformBlock(const std::string& name) const;
+    // the "model" matrix uniform the render queue sets for each draw,
+    // looked up once when the program is reflected
+    Uniform<glm::mat4> modelUniform() const;
+    // whether the program has the "draw" uniform block the render queue
+    // binds per draw, also worked out when the program is reflected
+    bool hasDrawBlock() const;
 
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
@@ -40,10 +79,71 @@ class Shader {
     void setMat3(const std::string& name, const glm::mat3& mat) const;
     void setMat4(const std::string& name, const glm::mat4& mat) const;
 
+    // location of an active uniform, or -1 if the program has no such
+    // uniform. Served from the table built after linking; names that aren't
+    // in it, like struct array elements past the first, are asked of the
+    // driver once and then added to it.
+    int uniformLocation(const std::string& name) const;
+
+    template <typename T>
+    Uniform<T> uniform(const std::string& name) const {
+        bool listed = false;
+        return Uniform<T>{findLocation(name, listed)};
+    }
+
+    void set(Uniform<bool> uniform, bool value) const;
+    void set(Uniform<int> uniform, int value) const;
+    void set(Uniform<float> uniform, float value) const;
+    void set(Uniform<glm::vec2> uniform, const glm::vec2& value) const;
+    void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
+    void set(Uniform<glm::vec4> uniform, const glm::vec4& value) const;
+    void set(Uniform<glm::mat2> uniform, const glm::mat2& mat) const;
+    void set(Uniform<glm::mat3> uniform, const glm::mat3& mat) const;
+    void set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const;
+
+    // number of glGetUniformLocation calls saved across all shaders, either by
+    // a table lookup or by setting through a pre-resolved Uniform handle.
+    // Only uniforms that exist count.
+    static std::uint64_t locationLookupsAvoided();
+
    private:
+    struct UniformEntry {
+        std::string name;
+        int location;
+    };
+    // every active uniform, sorted by name. Filled in once linked.
+    mutable std::vector<UniformEntry> uniforms;
+    mutable std::vector<std::string> uniformBlocks;
+    mutable Uniform<glm::mat4> modelMatrix;
+    mutable bool drawBlock{false};
+
+    // a deferred build still waiting to be resolved: its vertex, fragment
+    // and geometry shader (0 if it has none), or just its compute shader,
+    // when it was submitted and its program cache key
+    mutable bool linking{false};
+    mutable unsigned int stages[3]{};
+    std::chrono::steady_clock::time_point buildBegin;
+    std::uint64_t cacheKey{0};
+
+    Shader() = default;
+
+    // loads the program from the cache, or submits the compiles of the
+    // sources and the link, resolving right away for a Blocking build
+    void create(
+        const std::vector<std::pair<GLenum, const std::string*>>& sources,
+        ShaderBuild build);
+
+    // builds the uniform table from the linked program's active uniforms,
+    // and lists its uniform blocks. Every sampler gets a texture unit of its
+    // own, for Mesh to bind its textures to.
+    void reflectUniforms() const;
+    // the table lookup behind uniformLocation(), with listed telling whether
+    // the name was in the table already
+    int findLocation(const std::string& name, bool& listed) const;
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(unsigned int shader, std::string type);
+    void checkCompileErrors(unsigned int shader, std::string type) const;
 };
 }  // namespace personal::renderer::utility
 #endif
\ No newline at end of file
@@ -5,32 +5,71 @@
 #include <iostream>
 #include <memory>
 
+#include "dds.h"
+#include "gl_state.h"
 #include "stb_image.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
 
 namespace personal::renderer::utility {
 
-unsigned int loadTexture(std::string path) {
+namespace {
+
+// S3TC is an extension, though one every desktop driver has
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+}  // namespace
+
+SharedTexture::~SharedTexture() {
+    if (id) glDeleteTextures(1, &id);
+}
+
+DecodedImage decodeImage(const std::string& path) {
+    DecodedImage image;
+    image.pixels = {stbi_load(path.c_str(), &image.width, &image.height,
+                              &image.components, 0),
+                    stbi_image_free};
+    return image;
+}
+
+DecodedImage decodeImage(const unsigned char* data, std::size_t size) {
+    DecodedImage image;
+    image.pixels = {stbi_load_from_memory(data, static_cast<int>(size),
+                                          &image.width, &image.height,
+                                          &image.components, 0),
+                    stbi_image_free};
+    return image;
+}
+
+std::vector<DecodedImage> decodeImages(const std::vector<std::string>& paths) {
+    std::vector<DecodedImage> images(paths.size());
+    ThreadPool::shared().parallelFor(paths.size(), [&](std::size_t i) {
+        images[i] = decodeImage(paths[i]);
+    });
+    return images;
+}
+
+unsigned int uploadTexture(const DecodedImage& image) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    // unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    std::unique_ptr<unsigned char, decltype(&stbi_image_free)> data(
-        stbi_load(path.c_str(), &width, &height, &nrComponents, 0),
-        stbi_image_free);
-
-    if (data) {
+    if (image.pixels) {
         GLenum format{};
-        if (nrComponents == 1)
+        if (image.components == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.components == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.components == 4)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                     GL_UNSIGNED_BYTE, data.get());
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0,
+                     format, GL_UNSIGNED_BYTE, image.pixels.get());
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -38,13 +77,71 @@ unsigned int loadTexture(std::string path) {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                         GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << '\n';
     }
 
     return textureID;
 }
 
+unsigned int uploadCompressedTexture(const CompressedImage& image,
+                                     bool gamma) {
+    GLenum internalFormat =
+        compressedInternalFormat(image.format, gamma && image.srgb);
+    if (image.empty() || !internalFormat) return 0;
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    for (std::size_t i = 0; i < image.levels.size(); ++i) {
+        const CompressedImage::Level& level = image.levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i),
+                               internalFormat, level.width, level.height, 0,
+                               static_cast<GLsizei>(level.size),
+                               image.data(i));
+    }
+    // the chain may stop short of 1x1
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                    static_cast<GLint>(image.levels.size() - 1));
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    image.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR
+                                            : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
+
+unsigned int compressedInternalFormat(BlockFormat format, bool srgb) {
+    static const bool s3tc = hasExtension("GL_EXT_texture_compression_s3tc");
+    static const bool bptc =
+        GLAD_GL_VERSION_4_2 || hasExtension("GL_ARB_texture_compression_bptc");
+
+    switch (format) {
+        case BlockFormat::BC1:
+            if (!s3tc) return 0;
+            return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+                        : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3:
+            if (!s3tc) return 0;
+            return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+                        : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4:
+            return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::BC5:
+            return GL_COMPRESSED_RG_RGTC2;
+        case BlockFormat::BC7:
+            if (!bptc) return 0;
+            return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+                        : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return 0;
+}
+
+TextureHandle loadTexture(const std::string& path) {
+    return TextureCache::shared().load(path);
+}
+
 unsigned int loadCubemap(std::string path, std::vector<std::string> faces) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
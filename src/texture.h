@@ -1,11 +1,67 @@
 #ifndef TEXTURE_H
-#define TEXTIRE_H
+#define TEXTURE_H
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace personal::renderer::utility {
-unsigned int loadTexture(std::string path);
+
+struct CompressedImage;
+enum class BlockFormat : std::uint32_t;
+
+// Pixel data decoded on the CPU and ready to be uploaded into a GL texture.
+// Decoding needs no GL context, so it can happen on any thread.
+struct DecodedImage {
+    int width{0};
+    int height{0};
+    int components{0};
+    std::unique_ptr<unsigned char, void (*)(void*)> pixels{nullptr, nullptr};
+};
+
+// A GL texture shared through the TextureCache. The texture is deleted as
+// soon as the last handle to it goes away, so handles have to be released on
+// the thread that owns the GL context, while it is still current.
+struct SharedTexture {
+    unsigned int id{0};
+    // canonical path it was first loaded from, and a hash of the file
+    std::string path;
+    std::uint64_t contentHash{0};
+    // size of the pixel data uploaded, without mipmaps
+    std::size_t bytes{0};
+
+    SharedTexture() = default;
+    ~SharedTexture();
+
+    SharedTexture(const SharedTexture&) = delete;
+    SharedTexture& operator=(const SharedTexture&) = delete;
+};
+
+using TextureHandle = std::shared_ptr<const SharedTexture>;
+
+DecodedImage decodeImage(const std::string& path);
+DecodedImage decodeImage(const unsigned char* data, std::size_t size);
+// decodes every image concurrently on the shared thread pool. The i-th result
+// belongs to paths[i]; images that failed to decode have no pixels.
+std::vector<DecodedImage> decodeImages(const std::vector<std::string>& paths);
+// creates a mipmapped 2D texture from decoded pixels. Must be called on the
+// thread that owns the GL context.
+unsigned int uploadTexture(const DecodedImage& image);
+// creates a texture straight from block-compressed data and its stored mip
+// chain, without decoding or generating anything. sRGB images are only
+// sampled as sRGB with gamma, to match uploadTexture(). Returns 0 if the
+// driver doesn't support the block format.
+unsigned int uploadCompressedTexture(const CompressedImage& image,
+                                     bool gamma = false);
+// the GL internal format of a block format, or 0 if the driver can't sample
+// it
+unsigned int compressedInternalFormat(BlockFormat format, bool srgb);
+
+// loads a texture through the shared TextureCache, so loading the same file
+// again returns the texture already uploaded
+TextureHandle loadTexture(const std::string& path);
 unsigned int loadCubemap(std::string path, std::vector<std::string> faces);
 }  // namespace personal::renderer::utility
 
@@ -0,0 +1,153 @@
+#include "texture_cache.h"
+
+#include <filesystem>
+#include <iostream>
+
+#include "mapped_file.h"
+#include "texture_uploader.h"
+
+namespace personal::renderer::utility {
+
+namespace {
+
+std::string canonicalPath(const std::string& path) {
+    std::error_code error;
+    std::filesystem::path canonical =
+        std::filesystem::weakly_canonical(path, error);
+    return error ? path : canonical.generic_string();
+}
+
+// FNV-1a. 0 is reserved for files that couldn't be read.
+std::uint64_t hashContents(const unsigned char* data, std::size_t size) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash ? hash : 1;
+}
+
+}  // namespace
+
+TextureCache& TextureCache::shared() {
+    static TextureCache cache;
+    return cache;
+}
+
+TextureRequest TextureCache::prepare(const std::string& path) {
+    TextureRequest request;
+    request.path = canonicalPath(path);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        request.cached = lookup(byPath, request.path);
+        if (request.cached) {
+            ++hits;
+            return request;
+        }
+    }
+
+    // a cooked version is uploaded as it is, so it's hashed in place of the
+    // source
+    std::shared_ptr<MappedFile> file;
+    if (readCookedTexture(request.path, request.compressed))
+        file = request.compressed.file;
+    else
+        file = std::make_shared<MappedFile>(request.path);
+    if (!file->isOpen()) return request;
+    request.contentHash = hashContents(file->data(), file->size());
+    {
+        // the same image under another name
+        std::lock_guard<std::mutex> lock(mutex);
+        request.cached = lookup(byContent, request.contentHash);
+        if (request.cached) {
+            ++hits;
+            byPath[request.path] = request.cached;
+            request.compressed = CompressedImage{};
+            return request;
+        }
+        ++misses;
+    }
+
+    if (request.compressed.empty())
+        request.image = decodeImage(file->data(), file->size());
+    return request;
+}
+
+TextureHandle TextureCache::finish(TextureRequest& request,
+                                   TextureUploader* uploader) {
+    if (request.cached) return request.cached;
+
+    if (request.contentHash) {
+        // another request for the same image may have been finished first
+        std::lock_guard<std::mutex> lock(mutex);
+        TextureHandle cached = lookup(byContent, request.contentHash);
+        if (cached) {
+            byPath[request.path] = cached;
+            request.image.pixels.reset();
+            return request.cached = cached;
+        }
+    }
+
+    // textures are only ever added here, on the GL thread, so nothing can
+    // add this one while it uploads without the lock
+    auto texture = std::make_shared<SharedTexture>();
+    texture->path = request.path;
+    texture->contentHash = request.contentHash;
+    if (!request.compressed.empty()) {
+        texture->id = uploader ? uploader->upload(request.compressed)
+                               : uploadCompressedTexture(request.compressed);
+        texture->bytes = request.compressed.totalSize();
+        // without driver support for the format, fall back to the source
+        if (!texture->id) request.image = decodeImage(request.path);
+        request.compressed = CompressedImage{};
+    }
+    if (!texture->id) {
+        texture->id = uploader ? uploader->upload(request.image)
+                               : uploadTexture(request.image);
+        texture->bytes = static_cast<std::size_t>(request.image.width) *
+                         static_cast<std::size_t>(request.image.height) *
+                         static_cast<std::size_t>(request.image.components);
+        if (!request.image.pixels) {
+            std::cout << "Texture failed to load at path: " << request.path
+                      << '\n';
+            return request.cached = texture;
+        }
+        request.image.pixels.reset();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    byPath[request.path] = texture;
+    byContent[request.contentHash] = texture;
+    return request.cached = texture;
+}
+
+TextureHandle TextureCache::load(const std::string& path) {
+    TextureRequest request = prepare(path);
+    return finish(request);
+}
+
+TextureCache::Stats TextureCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result;
+    result.hits = hits;
+    result.misses = misses;
+    for (const auto& [hash, entry] : byContent) {
+        if (TextureHandle texture = entry.lock()) {
+            ++result.textures;
+            result.bytes += texture->bytes;
+        }
+    }
+    return result;
+}
+
+template <typename Map, typename Key>
+TextureHandle TextureCache::lookup(Map& map, const Key& key) {
+    auto it = map.find(key);
+    if (it == map.end()) return nullptr;
+
+    TextureHandle texture = it->second.lock();
+    if (!texture) map.erase(it);
+    return texture;
+}
+
+}  // namespace personal::renderer::utility
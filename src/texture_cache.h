@@ -0,0 +1,87 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "dds.h"
+#include "texture.h"
+
+namespace personal::renderer::utility {
+
+class TextureUploader;
+
+// A texture on its way into the cache: either already cached, or read and
+// waiting to be uploaded, as its cooked blocks when there are any and as
+// decoded pixels otherwise
+struct TextureRequest {
+    // canonical path, and hash of the file contents (0 if it wasn't read)
+    std::string path;
+    std::uint64_t contentHash{0};
+    TextureHandle cached;
+    CompressedImage compressed;
+    DecodedImage image;
+};
+
+// Process-wide cache of 2D textures, keyed by canonical path and by a hash
+// of the file contents, so the same image is only decoded and uploaded once
+// no matter how many models or paths refer to it. The cache only holds weak
+// references: a texture is deleted as soon as its last handle is dropped.
+//
+// Loading is split like model loading. prepare() does the file reading and
+// decoding and may be called from any thread; finish() uploads and has to be
+// called on the thread owning the GL context.
+class TextureCache {
+   public:
+    struct Stats {
+        // requests served from the cache, by path or by content
+        std::size_t hits{0};
+        std::size_t misses{0};
+        // textures alive right now, and their pixel data size
+        std::size_t textures{0};
+        std::size_t bytes{0};
+    };
+
+    static TextureCache& shared();
+
+    TextureCache() = default;
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // looks the path up, then, if needed, reads the file and looks up its
+    // contents, and only decodes it if both miss and there is no cooked
+    // version (see texture_cooker.cpp). Thread-safe.
+    TextureRequest prepare(const std::string& path);
+    // returns the cached texture, uploading the decoded image first if no
+    // other request has in the meantime. Files that could not be loaded get
+    // an empty texture that isn't cached. Uploads go through the uploader
+    // when given one.
+    TextureHandle finish(TextureRequest& request,
+                         TextureUploader* uploader = nullptr);
+    // prepare() and finish() in one go
+    TextureHandle load(const std::string& path);
+
+    Stats stats() const;
+
+   private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, std::weak_ptr<const SharedTexture>>
+        byPath;
+    std::unordered_map<std::uint64_t, std::weak_ptr<const SharedTexture>>
+        byContent;
+    std::size_t hits{0};
+    std::size_t misses{0};
+
+    // the live texture under a key, dropping the entry if it expired. The
+    // mutex must be held.
+    template <typename Map, typename Key>
+    static TextureHandle lookup(Map& map, const Key& key);
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // TEXTURE_CACHE_H
@@ -0,0 +1,169 @@
+// Offline texture cooker: converts source images into block-compressed DDS
+// files with their full mip chain, which the texture loaders upload as they
+// are instead of decoding the image and generating mips at runtime.
+//
+//   texture_cooker [--force] [--bc5-normals] [file or directory...]
+//
+// Directories are searched recursively, by default res/. The output goes
+// next to each source, as '<source>.v2.dds' (see cookedPath()), and is only
+// rebuilt when the source is newer. Images are stored bottom row first, the
+// way the app decodes them. Colour textures become sRGB BC1, or BC3 when
+// they have alpha. Normal maps (recognised by name) stay linear, as BC1
+// unless --bc5-normals is given, which needs shaders that rebuild z from x
+// and y.
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "block_compression.h"
+#include "dds.h"
+#include "stb_image.h"
+#include "thread_pool.h"
+
+using namespace personal::renderer;
+
+namespace {
+
+struct Options {
+    bool force{false};
+    bool bc5Normals{false};
+    std::vector<std::string> paths;
+};
+
+std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](char c) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    });
+    return text;
+}
+
+bool isSourceImage(const std::filesystem::path& path) {
+    std::string extension = lowercase(path.extension().string());
+    return extension == ".png" || extension == ".jpg" ||
+           extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+}
+
+bool isNormalMap(const std::filesystem::path& path) {
+    std::string name = lowercase(path.filename().string());
+    return name.find("normal") != std::string::npos ||
+           name.find("_n.") != std::string::npos ||
+           name.find("_nrm") != std::string::npos ||
+           name.find("_ddn") != std::string::npos;
+}
+
+bool upToDate(const std::string& source) {
+    std::error_code error;
+    auto cookedTime = std::filesystem::last_write_time(
+        utility::cookedPath(source), error);
+    if (error) return false;
+    return std::filesystem::last_write_time(source, error) <= cookedTime &&
+           !error;
+}
+
+// cooks one image, returning what happened as a line of text
+bool cook(const std::string& source, const Options& options,
+          std::string& report) {
+    int width, height, components;
+    unsigned char* pixels =
+        stbi_load(source.c_str(), &width, &height, &components, 4);
+    if (!pixels) {
+        report = "ERROR::TEXTURE_COOKER::DECODE_FAILED: " + source + ": " +
+                 stbi_failure_reason();
+        return false;
+    }
+
+    utility::BlockFormat format = utility::BlockFormat::BC1;
+    bool srgb = true;
+    if (isNormalMap(source)) {
+        srgb = false;
+        if (options.bc5Normals) format = utility::BlockFormat::BC5;
+    } else {
+        std::size_t pixelCount =
+            static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+        for (std::size_t i = 0; i < pixelCount; ++i) {
+            if (pixels[i * 4 + 3] != 255) {
+                format = utility::BlockFormat::BC3;
+                break;
+            }
+        }
+    }
+
+    utility::CompressedImage image =
+        utility::compressTexture(pixels, width, height, format, srgb);
+    stbi_image_free(pixels);
+
+    std::string destination = utility::cookedPath(source);
+    if (image.empty() || !utility::writeDDS(destination, image)) {
+        report = "ERROR::TEXTURE_COOKER::WRITE_FAILED: " + destination;
+        return false;
+    }
+
+    std::ostringstream line;
+    line << "COOKED:: " << source << ": " << width << 'x' << height << ' '
+         << utility::blockFormatName(format) << (srgb ? " sRGB, " : ", ")
+         << image.levels.size() << " mips, "
+         << image.totalSize() / 1024 << " KB";
+    report = line.str();
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--force"))
+            options.force = true;
+        else if (!std::strcmp(argv[i], "--bc5-normals"))
+            options.bc5Normals = true;
+        else
+            options.paths.push_back(argv[i]);
+    }
+    if (options.paths.empty()) options.paths.push_back("res");
+    // the app and the benchmark flip on load, so the UVs expect the bottom
+    // row first
+    stbi_set_flip_vertically_on_load(true);
+
+    std::vector<std::string> sources;
+    for (const std::string& path : options.paths) {
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            for (const auto& entry :
+                 std::filesystem::recursive_directory_iterator(path, error))
+                if (entry.is_regular_file() && isSourceImage(entry.path()))
+                    sources.push_back(entry.path().generic_string());
+        } else if (std::filesystem::is_regular_file(path, error)) {
+            sources.push_back(path);
+        } else {
+            std::cout << "ERROR::TEXTURE_COOKER::NOT_FOUND: " << path << '\n';
+            return EXIT_FAILURE;
+        }
+    }
+    std::sort(sources.begin(), sources.end());
+
+    std::vector<std::string> reports(sources.size());
+    std::atomic<std::size_t> failed{0};
+    std::atomic<std::size_t> skipped{0};
+    utility::ThreadPool::shared().parallelFor(
+        sources.size(), [&](std::size_t i) {
+            if (!options.force && upToDate(sources[i])) {
+                ++skipped;
+                return;
+            }
+            if (!cook(sources[i], options, reports[i])) ++failed;
+        });
+
+    for (const std::string& report : reports)
+        if (!report.empty()) std::cout << report << '\n';
+    std::cout << "TEXTURE_COOKER:: " << sources.size() << " textures, "
+              << skipped << " up to date, " << failed << " failed\n";
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
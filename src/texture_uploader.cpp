@@ -0,0 +1,242 @@
+#include "texture_uploader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// keeps every staged image on a boundary any pixel or block type is happy
+// with
+const std::size_t STAGING_ALIGNMENT = 16;
+// how long a single wait for the GPU may block, in nanoseconds, before it is
+// retried
+const GLuint64 WAIT_TIMEOUT = 1000000;
+
+struct PixelFormat {
+    GLenum internalFormat;
+    GLenum format;
+};
+
+PixelFormat pixelFormat(int components) {
+    switch (components) {
+        case 1:
+            return {GL_R8, GL_RED};
+        case 2:
+            return {GL_RG8, GL_RG};
+        case 3:
+            return {GL_RGB8, GL_RGB};
+        default:
+            return {GL_RGBA8, GL_RGBA};
+    }
+}
+
+GLsizei fullMipCount(int width, int height) {
+    GLsizei levels = 1;
+    while (width > 1 || height > 1) {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        ++levels;
+    }
+    return levels;
+}
+
+void setSamplerParameters(GLsizei levels) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+// an offset into the bound unpack buffer, as GL takes it
+const void* bufferOffset(std::size_t offset) {
+    return reinterpret_cast<const void*>(static_cast<std::uintptr_t>(offset));
+}
+
+}  // namespace
+
+TextureUploader::TextureUploader(std::size_t ringSize) : capacity(ringSize) {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    if (GLAD_GL_VERSION_4_4) {
+        const GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER,
+                        static_cast<GLsizeiptr>(capacity), nullptr, flags);
+        mapping = static_cast<unsigned char*>(glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(capacity),
+            flags));
+    } else {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(capacity),
+                     nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+TextureUploader::~TextureUploader() {
+    for (const Fence& pending : fences) glDeleteSync(pending.sync);
+    if (mapping) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+unsigned int TextureUploader::upload(const DecodedImage& image) {
+    // nothing to stage, but callers still expect a texture name
+    if (!image.pixels) return uploadTexture(image);
+
+    PixelFormat format = pixelFormat(image.components);
+    GLsizei levels = fullMipCount(image.width, image.height);
+    std::size_t size = static_cast<std::size_t>(image.width) *
+                       static_cast<std::size_t>(image.height) *
+                       static_cast<std::size_t>(image.components);
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    if (GLAD_GL_VERSION_4_2)
+        glTexStorage2D(GL_TEXTURE_2D, levels, format.internalFormat,
+                       image.width, image.height);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    std::size_t offset = stage(image.pixels.get(), size);
+    bool staged = offset != capacity;
+    const void* source = bufferOffset(offset);
+    if (!staged) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        source = image.pixels.get();
+        ++uploadStats.directUploads;
+    }
+
+    // rows of RGB and single channel images needn't be 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (GLAD_GL_VERSION_4_2)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height,
+                        format.format, GL_UNSIGNED_BYTE, source);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(format.internalFormat),
+                     image.width, image.height, 0, format.format,
+                     GL_UNSIGNED_BYTE, source);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (staged) fence(offset, offset + size);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    glGenerateMipmap(GL_TEXTURE_2D);
+    setSamplerParameters(levels);
+    ++uploadStats.uploads;
+    return textureID;
+}
+
+unsigned int TextureUploader::upload(const CompressedImage& image,
+                                     bool gamma) {
+    GLenum internalFormat =
+        compressedInternalFormat(image.format, gamma && image.srgb);
+    if (image.empty() || !internalFormat) return 0;
+
+    GLsizei levels = static_cast<GLsizei>(image.levels.size());
+    const CompressedImage::Level& top = image.levels.front();
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    if (GLAD_GL_VERSION_4_2)
+        glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, top.width,
+                       top.height);
+
+    // the levels are stored back to back, both in DDS files and in freshly
+    // compressed images, so they are staged in one go
+    std::size_t size = image.totalSize();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    std::size_t offset = stage(image.data(0), size);
+    bool staged = offset != capacity;
+    if (!staged) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        ++uploadStats.directUploads;
+    }
+
+    for (GLsizei i = 0; i < levels; ++i) {
+        const CompressedImage::Level& level = image.levels[i];
+        const void* source =
+            staged ? bufferOffset(offset + level.offset - top.offset)
+                   : image.data(static_cast<std::size_t>(i));
+        if (GLAD_GL_VERSION_4_2)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width,
+                                      level.height, internalFormat,
+                                      static_cast<GLsizei>(level.size),
+                                      source);
+        else
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat,
+                                   level.width, level.height, 0,
+                                   static_cast<GLsizei>(level.size), source);
+    }
+    if (staged) fence(offset, offset + size);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    setSamplerParameters(levels);
+    ++uploadStats.uploads;
+    return textureID;
+}
+
+const TextureUploader::Stats& TextureUploader::stats() const {
+    return uploadStats;
+}
+
+std::size_t TextureUploader::stage(const void* data, std::size_t size) {
+    if (size > capacity) return capacity;
+
+    std::size_t begin =
+        (head + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+    if (begin + size > capacity) begin = 0;
+    std::size_t end = begin + size;
+
+    // ranges are handed out in ring order, so the oldest fences are the ones
+    // in the way
+    while (!fences.empty() && fences.front().begin < end &&
+           begin < fences.front().end) {
+        waitFor(fences.front());
+        glDeleteSync(fences.front().sync);
+        fences.pop_front();
+    }
+
+    if (mapping) {
+        std::memcpy(mapping + begin, data, size);
+    } else {
+        // the fences already guarantee the GPU is done with the range
+        void* target = glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER, static_cast<GLintptr>(begin),
+            static_cast<GLsizeiptr>(size),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                GL_MAP_UNSYNCHRONIZED_BIT);
+        if (!target) return capacity;
+        std::memcpy(target, data, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    head = end;
+    uploadStats.stagedBytes += size;
+    return begin;
+}
+
+void TextureUploader::fence(std::size_t begin, std::size_t end) {
+    fences.push_back({begin, end, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+}
+
+void TextureUploader::waitFor(const Fence& pending) {
+    GLenum result = glClientWaitSync(pending.sync, 0, 0);
+    if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+        return;
+
+    ++uploadStats.stalls;
+    do {
+        result = glClientWaitSync(pending.sync, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  WAIT_TIMEOUT);
+    } while (result == GL_TIMEOUT_EXPIRED);
+}
+
+}  // namespace personal::renderer::utility
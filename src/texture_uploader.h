@@ -0,0 +1,78 @@
+#ifndef TEXTURE_UPLOADER_H
+#define TEXTURE_UPLOADER_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <deque>
+
+#include "dds.h"
+#include "texture.h"
+
+namespace personal::renderer::utility {
+
+// Uploads textures through a ring of pixel unpack buffer (PBO) memory, so
+// the driver can copy the pixels to the GPU asynchronously instead of
+// stalling on a copy from client memory. Pixels are copied into mapped
+// staging memory once, and the textures get immutable storage with all
+// their levels allocated up front.
+//
+// Each upload fences the part of the ring it used; the ring only waits when
+// it wraps around onto a part the GPU hasn't finished reading yet. With GL
+// 4.4 the ring is mapped persistently, otherwise every upload maps its range
+// unsynchronized, which the fences make safe. Without GL 4.2 the textures
+// fall back to mutable storage.
+//
+// Has to be used on the thread owning the GL context.
+class TextureUploader {
+   public:
+    static const std::size_t DEFAULT_RING_SIZE = 32 * 1024 * 1024;
+
+    struct Stats {
+        std::size_t uploads{0};
+        std::size_t stagedBytes{0};
+        // times the ring had to wait for the GPU before it could be reused
+        std::size_t stalls{0};
+        // images larger than the ring, uploaded from client memory
+        std::size_t directUploads{0};
+    };
+
+    explicit TextureUploader(std::size_t ringSize = DEFAULT_RING_SIZE);
+    ~TextureUploader();
+
+    TextureUploader(const TextureUploader&) = delete;
+    TextureUploader& operator=(const TextureUploader&) = delete;
+
+    // same results as uploadTexture() and uploadCompressedTexture()
+    unsigned int upload(const DecodedImage& image);
+    unsigned int upload(const CompressedImage& image, bool gamma = false);
+
+    const Stats& stats() const;
+
+   private:
+    // a range of the ring the GPU may still be reading from
+    struct Fence {
+        std::size_t begin;
+        std::size_t end;
+        GLsync sync;
+    };
+
+    unsigned int buffer{0};
+    std::size_t capacity;
+    std::size_t head{0};
+    // only set when persistently mapped
+    unsigned char* mapping{nullptr};
+    std::deque<Fence> fences;
+    Stats uploadStats;
+
+    // copies size bytes into the ring, returning their offset in it, or
+    // capacity if they don't fit. The buffer has to be bound to
+    // GL_PIXEL_UNPACK_BUFFER.
+    std::size_t stage(const void* data, std::size_t size);
+    void fence(std::size_t begin, std::size_t end);
+    void waitFor(const Fence& pending);
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // TEXTURE_UPLOADER_H
@@ -0,0 +1,107 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace personal::renderer::utility {
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+    for (unsigned int i = 0; i < threadCount; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+    // at least one worker even on a single hardware thread, since submitted
+    // tasks are only ever run by workers
+    static ThreadPool pool(
+        std::max(2u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+std::size_t ThreadPool::size() const { return workers.size(); }
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::parallelFor(std::size_t count,
+                             const std::function<void(std::size_t)>& body) {
+    if (count == 0) return;
+
+    std::atomic<std::size_t> next{0};
+    auto drain = [&]() {
+        for (std::size_t i = next++; i < count; i = next++) body(i);
+    };
+
+    // one helper per worker (at most one per item); the calling thread works
+    // through the items as well rather than sitting idle
+    std::size_t helpers = std::min(workers.size(), count - 1);
+    std::atomic<std::size_t> running{helpers};
+    std::mutex doneMutex;
+    std::condition_variable done;
+
+    for (std::size_t h = 0; h < helpers; ++h) {
+        submit([&]() {
+            drain();
+            std::lock_guard<std::mutex> lock(doneMutex);
+            if (--running == 0) done.notify_one();
+        });
+    }
+
+    drain();
+
+    // the helpers reference this stack frame, so wait for every one of them to
+    // exit. Keep executing queued tasks meanwhile so nested parallelFor calls
+    // made from a worker can't starve.
+    while (running > 0) {
+        if (runPendingTask()) continue;
+        std::unique_lock<std::mutex> lock(doneMutex);
+        done.wait_for(lock, std::chrono::milliseconds(1),
+                      [&]() { return running == 0; });
+    }
+    // the last helper may still be unlocking doneMutex
+    std::lock_guard<std::mutex> lock(doneMutex);
+}
+
+void ThreadPool::workerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock,
+                               [this]() { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+bool ThreadPool::runPendingTask() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tasks.empty()) return false;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+    }
+    task();
+    return true;
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,50 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace personal::renderer::utility {
+
+// A fixed set of worker threads pulling tasks from a shared queue. Used for
+// CPU-heavy loading work (image decoding, mesh processing) that has no need
+// for the GL context.
+class ThreadPool {
+   public:
+    explicit ThreadPool(unsigned int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // process-wide pool with one worker per hardware thread (minus the
+    // calling thread, which takes part in parallelFor), but at least one
+    static ThreadPool& shared();
+
+    std::size_t size() const;
+    void submit(std::function<void()> task);
+
+    // runs body(i) for every i in [0, count) spread across the workers and the
+    // calling thread. Returns once every call has finished.
+    void parallelFor(std::size_t count,
+                     const std::function<void(std::size_t)>& body);
+
+   private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    bool stopping{false};
+
+    void workerLoop();
+    bool runPendingTask();
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // THREAD_POOL_H
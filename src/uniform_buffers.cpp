@@ -0,0 +1,193 @@
+#include "uniform_buffers.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// how long a single wait for the GPU may block, in nanoseconds, before it is
+// retried
+const GLuint64 WAIT_TIMEOUT = 1000000;
+const std::size_t NOT_BOUND = ~std::size_t{0};
+
+}  // namespace
+
+DrawUniforms::DrawUniforms(const glm::mat4& transform)
+    : model(transform),
+      normalMatrix(glm::transpose(glm::inverse(glm::mat3(transform)))) {}
+
+UniformBuffers::UniformBuffers(std::size_t drawCapacity)
+    : drawCapacity(std::max<std::size_t>(drawCapacity, 1)),
+      part(FRAMES_IN_FLIGHT - 1),
+      boundDraw(NOT_BOUND) {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    std::size_t align = static_cast<std::size_t>(std::max(alignment, 1));
+    std::size_t block = std::max(sizeof(FrameUniforms), sizeof(DrawUniforms));
+    stride = (block + align - 1) / align * align;
+    allocate();
+}
+
+UniformBuffers::~UniformBuffers() {
+    for (GLsync& sync : fences)
+        if (sync) glDeleteSync(sync);
+    release();
+}
+
+void UniformBuffers::beginFrame(const FrameUniforms& frame) {
+    frameStats = Stats{};
+    part = (part + 1) % FRAMES_IN_FLIGHT;
+    if (fences[part]) {
+        waitFor(fences[part]);
+        glDeleteSync(fences[part]);
+        fences[part] = nullptr;
+    }
+
+    frameData = frame;
+    head = 0;
+    flushed = 0;
+    outOfSpace = false;
+    lastDraw = write(&frameData, sizeof(FrameUniforms));
+    flush();
+    bindFrame();
+}
+
+void UniformBuffers::reserveDraws(std::size_t count) {
+    if (head + count * stride <= partSize) return;
+
+    // every part is reallocated, so nothing may be reading any of them
+    for (GLsync& sync : fences) {
+        if (!sync) continue;
+        waitFor(sync);
+        glDeleteSync(sync);
+        sync = nullptr;
+    }
+    release();
+    drawCapacity = std::max(drawCapacity * 2, count);
+    allocate();
+
+    part = 0;
+    head = 0;
+    flushed = 0;
+    frameStats.draws = 0;
+    frameStats.bytes = 0;
+    lastDraw = write(&frameData, sizeof(FrameUniforms));
+    flush();
+    bindFrame();
+}
+
+std::size_t UniformBuffers::pushDraw(const DrawUniforms& draw) {
+    if (head + stride > partSize) {
+        // growing would move the blocks already handed out, and overwriting
+        // the last one would change a draw that is already queued
+        if (!outOfSpace)
+            std::cout << "ERROR::UNIFORM_BUFFERS::OUT_OF_SPACE: draw pushed "
+                         "without reserving room for it\n";
+        outOfSpace = true;
+        return lastDraw;
+    }
+    ++frameStats.draws;
+    lastDraw = write(&draw, sizeof(DrawUniforms));
+    return lastDraw;
+}
+
+void UniformBuffers::flush() {
+    if (mapping || flushed == head) return;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    // the fences already guarantee the GPU is done with the range
+    void* target = glMapBufferRange(
+        GL_UNIFORM_BUFFER, static_cast<GLintptr>(part * partSize + flushed),
+        static_cast<GLsizeiptr>(head - flushed),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+            GL_MAP_UNSYNCHRONIZED_BIT);
+    if (target) {
+        std::memcpy(target, staging.data() + flushed, head - flushed);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    flushed = head;
+}
+
+void UniformBuffers::bindDraw(std::size_t offset) {
+    if (offset == boundDraw) return;
+    glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_UNIFORM_BINDING, buffer,
+                      static_cast<GLintptr>(offset),
+                      static_cast<GLsizeiptr>(sizeof(DrawUniforms)));
+    boundDraw = offset;
+}
+
+void UniformBuffers::endFrame() {
+    fences[part] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+const UniformBuffers::Stats& UniformBuffers::stats() const {
+    return frameStats;
+}
+
+void UniformBuffers::allocate() {
+    partSize = stride * (drawCapacity + 1);
+    GLsizeiptr size = static_cast<GLsizeiptr>(partSize * FRAMES_IN_FLIGHT);
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    if (GLAD_GL_VERSION_4_4) {
+        const GLbitfield flags =
+            GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+        mapping = static_cast<unsigned char*>(
+            glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+        staging.clear();
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        staging.resize(partSize);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffers::release() {
+    if (mapping) {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        mapping = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    boundDraw = NOT_BOUND;
+}
+
+std::size_t UniformBuffers::write(const void* data, std::size_t size) {
+    std::size_t offset = head;
+    if (mapping)
+        std::memcpy(mapping + part * partSize + offset, data, size);
+    else
+        std::memcpy(staging.data() + offset, data, size);
+    head += stride;
+    frameStats.bytes += size;
+    return part * partSize + offset;
+}
+
+void UniformBuffers::bindFrame() {
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, buffer,
+                      static_cast<GLintptr>(part * partSize),
+                      static_cast<GLsizeiptr>(sizeof(FrameUniforms)));
+    boundDraw = NOT_BOUND;
+}
+
+void UniformBuffers::waitFor(GLsync sync) {
+    GLenum result = glClientWaitSync(sync, 0, 0);
+    if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+        return;
+
+    ++frameStats.stalls;
+    do {
+        result =
+            glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, WAIT_TIMEOUT);
+    } while (result == GL_TIMEOUT_EXPIRED);
+}
+
+}  // namespace personal::renderer::utility
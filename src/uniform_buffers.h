@@ -0,0 +1,123 @@
+#ifndef UNIFORM_BUFFERS_H
+#define UNIFORM_BUFFERS_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace personal::renderer::utility {
+
+// uniform buffer binding points, the same for every program
+const unsigned int FRAME_UNIFORM_BINDING = 0;
+const unsigned int DRAW_UNIFORM_BINDING = 1;
+// frames the CPU may run ahead of the GPU before the ring has to wait
+const std::size_t FRAMES_IN_FLIGHT = 3;
+
+// std140 layout of 'layout(std140) uniform matrices', set once per frame
+struct FrameUniforms {
+    glm::mat4 projection{1.0f};
+    glm::mat4 view{1.0f};
+};
+
+// std140 layout of 'layout(std140) uniform draw', set per draw. The normal
+// matrix is a mat3 padded to a mat4, so shaders read mat3(normalMatrix).
+struct DrawUniforms {
+    glm::mat4 model{1.0f};
+    glm::mat4 normalMatrix{1.0f};
+
+    DrawUniforms() = default;
+    // the normal matrix is derived from the model matrix
+    explicit DrawUniforms(const glm::mat4& model);
+};
+
+// Per-frame and per-draw uniform blocks, written into one uniform buffer
+// that is split into FRAMES_IN_FLIGHT parts used round robin. Each frame's
+// part starts with its FrameUniforms, bound at FRAME_UNIFORM_BINDING for the
+// whole frame, followed by DrawUniforms blocks, each bound with
+// glBindBufferRange at DRAW_UNIFORM_BINDING before its draw. Blocks are
+// spaced by GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, so setting a draw's uniforms
+// is a single copy and a range bind.
+//
+// A part is fenced at the end of its frame and only written again once the
+// GPU is done with it. With GL 4.4 the buffer is mapped persistently and
+// blocks are written in place; otherwise they are gathered on the CPU and
+// flush() copies them into an unsynchronized mapping, which the fences make
+// safe.
+//
+// Has to be used on the thread owning the GL context.
+class UniformBuffers {
+   public:
+    static const std::size_t DEFAULT_DRAW_CAPACITY = 4096;
+
+    // counts of the last frame
+    struct Stats {
+        std::size_t draws{0};
+        std::size_t bytes{0};
+        // times the frame had to wait for the GPU before reusing its part
+        std::size_t stalls{0};
+    };
+
+    explicit UniformBuffers(std::size_t drawCapacity = DEFAULT_DRAW_CAPACITY);
+    ~UniformBuffers();
+
+    UniformBuffers(const UniformBuffers&) = delete;
+    UniformBuffers& operator=(const UniformBuffers&) = delete;
+
+    // moves on to the next part of the ring, waiting for the GPU if it is
+    // still reading it, and binds the frame's uniforms
+    void beginFrame(const FrameUniforms& frame);
+    // makes room for count more draw blocks this frame. Growing the buffer
+    // waits for every frame in flight and drops the draw blocks already
+    // written this frame, so reserve before pushing any.
+    void reserveDraws(std::size_t count);
+    // copies a draw's uniforms into the frame's part, returning the offset
+    // to bind them at. There has to be room reserved for it; without any the
+    // draw gets the previous draw's block.
+    std::size_t pushDraw(const DrawUniforms& draw);
+    // makes the blocks pushed so far visible to the GPU
+    void flush();
+    // binds the draw block at offset, unless it is bound already
+    void bindDraw(std::size_t offset);
+    // fences the frame's part of the ring
+    void endFrame();
+
+    const Stats& stats() const;
+
+   private:
+    unsigned int buffer{0};
+    // bytes between consecutive blocks
+    std::size_t stride;
+    std::size_t drawCapacity;
+    // bytes per frame, the frame block and drawCapacity draw blocks
+    std::size_t partSize{0};
+    std::size_t part{0};
+    // next free byte in the part, and the first one not flushed yet
+    std::size_t head{0};
+    std::size_t flushed{0};
+    std::size_t boundDraw;
+    // offset of the last draw block pushed this frame, handed out again for
+    // draws pushed without room, which are reported once per frame
+    std::size_t lastDraw{0};
+    bool outOfSpace{false};
+    FrameUniforms frameData;
+    // only set when persistently mapped
+    unsigned char* mapping{nullptr};
+    // the part being written, when it isn't mapped
+    std::vector<unsigned char> staging;
+    GLsync fences[FRAMES_IN_FLIGHT]{};
+    Stats frameStats;
+
+    void allocate();
+    void release();
+    // copies size bytes to the head of the part, returning their offset in
+    // the buffer
+    std::size_t write(const void* data, std::size_t size);
+    void bindFrame();
+    void waitFor(GLsync sync);
+};
+
+}  // namespace personal::renderer::utility
+
+#endif  // UNIFORM_BUFFERS_H
@@ -0,0 +1,159 @@
+#include "vertex_packing.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "mesh.h"
+
+namespace personal::renderer::utility {
+
+namespace {
+
+// smallest non-zero snorm16 step. Tangents keep their bitangent sign in the
+// sign of y, so the magnitude of y is biased by this to never quantize to 0.
+const float SNORM16_STEP = 1.0f / 32767.0f;
+
+float signNotZero(float value) { return value >= 0.0f ? 1.0f : -1.0f; }
+
+// tangent octahedral encoding with the handedness of the tangent frame stored
+// in the sign of y: y is remapped from [-1, 1] to [step, 1] and then
+// multiplied by the bitangent sign
+glm::vec2 packTangent(const glm::vec3& normal, const glm::vec3& tangent,
+                      const glm::vec3& bitangent) {
+    glm::vec2 e = octEncode(tangent);
+    float handedness =
+        signNotZero(glm::dot(glm::cross(normal, tangent), bitangent));
+    float y = (e.y * 0.5f + 0.5f) * (1.0f - SNORM16_STEP) + SNORM16_STEP;
+    return glm::vec2(e.x, y * handedness);
+}
+
+glm::vec3 safeNormalize(const glm::vec3& v, const glm::vec3& fallback) {
+    float length = glm::length(v);
+    return length > 1e-12f ? v / length : fallback;
+}
+
+}  // namespace
+
+std::uint16_t floatToHalf(float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    std::uint32_t sign = (bits >> 16) & 0x8000u;
+    std::uint32_t exponent = (bits >> 23) & 0xffu;
+    std::uint32_t mantissa = bits & 0x7fffffu;
+
+    // NaN and infinity
+    if (exponent == 0xffu)
+        return static_cast<std::uint16_t>(sign | 0x7c00u |
+                                          (mantissa ? 0x200u : 0u));
+
+    int halfExponent = static_cast<int>(exponent) - 127 + 15;
+    // overflow clamps to infinity
+    if (halfExponent >= 0x1f) return static_cast<std::uint16_t>(sign | 0x7c00u);
+
+    if (halfExponent <= 0) {
+        // too small even for a denormal half
+        if (halfExponent < -10) return static_cast<std::uint16_t>(sign);
+        // denormal: shift the implicit leading one into the mantissa
+        mantissa |= 0x800000u;
+        std::uint32_t shift = static_cast<std::uint32_t>(14 - halfExponent);
+        std::uint32_t half = mantissa >> shift;
+        // round to nearest even
+        std::uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        std::uint32_t halfway = 1u << (shift - 1u);
+        if (remainder > halfway || (remainder == halfway && (half & 1u)))
+            ++half;
+        return static_cast<std::uint16_t>(sign | half);
+    }
+
+    std::uint32_t half = sign |
+                         (static_cast<std::uint32_t>(halfExponent) << 10) |
+                         (mantissa >> 13);
+    // round to nearest even; a carry into the exponent is still correct
+    std::uint32_t remainder = mantissa & 0x1fffu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u))) ++half;
+    return static_cast<std::uint16_t>(half);
+}
+
+std::int16_t floatToSnorm16(float value) {
+    float clamped = std::fmax(-1.0f, std::fmin(1.0f, value));
+    return static_cast<std::int16_t>(std::lround(clamped * 32767.0f));
+}
+
+glm::vec2 octEncode(const glm::vec3& n) {
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (l1 <= 0.0f) return glm::vec2(0.0f, 0.0f);
+
+    glm::vec2 e(n.x / l1, n.y / l1);
+    // fold the lower hemisphere over the diagonals
+    if (n.z < 0.0f) {
+        glm::vec2 folded((1.0f - std::fabs(e.y)) * signNotZero(e.x),
+                         (1.0f - std::fabs(e.x)) * signNotZero(e.y));
+        e = folded;
+    }
+    return e;
+}
+
+glm::vec3 octDecode(const glm::vec2& e) {
+    glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    if (n.z < 0.0f) {
+        float x = (1.0f - std::fabs(e.y)) * signNotZero(e.x);
+        float y = (1.0f - std::fabs(e.x)) * signNotZero(e.y);
+        n.x = x;
+        n.y = y;
+    }
+    return glm::normalize(n);
+}
+
+std::vector<PackedVertex> packVertices(const Vertex* vertices,
+                                       std::size_t count,
+                                       VertexQuantization& quantization) {
+    std::vector<PackedVertex> packed(count);
+    if (count == 0) {
+        quantization = VertexQuantization{};
+        return packed;
+    }
+
+    glm::vec3 minimum = vertices[0].position;
+    glm::vec3 maximum = vertices[0].position;
+    for (std::size_t i = 1; i < count; ++i) {
+        minimum = glm::min(minimum, vertices[i].position);
+        maximum = glm::max(maximum, vertices[i].position);
+    }
+
+    // positions become [-1, 1] across the bounding box. Flat axes get a
+    // non-zero scale so the division below stays finite.
+    quantization.offset = (minimum + maximum) * 0.5f;
+    quantization.scale = glm::max((maximum - minimum) * 0.5f, glm::vec3(1e-8f));
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const Vertex& vertex = vertices[i];
+        PackedVertex& out = packed[i];
+
+        glm::vec3 position =
+            (vertex.position - quantization.offset) / quantization.scale;
+        out.position[0] = floatToSnorm16(position.x);
+        out.position[1] = floatToSnorm16(position.y);
+        out.position[2] = floatToSnorm16(position.z);
+        out.position[3] = 0;
+
+        glm::vec3 normal =
+            safeNormalize(vertex.normal, glm::vec3(0.0f, 0.0f, 1.0f));
+        glm::vec2 n = octEncode(normal);
+        out.normal[0] = floatToSnorm16(n.x);
+        out.normal[1] = floatToSnorm16(n.y);
+
+        glm::vec3 tangent =
+            safeNormalize(vertex.tangent, glm::vec3(1.0f, 0.0f, 0.0f));
+        glm::vec2 t = packTangent(normal, tangent, vertex.bitangent);
+        out.tangent[0] = floatToSnorm16(t.x);
+        out.tangent[1] = floatToSnorm16(t.y);
+
+        out.texCoords[0] = floatToHalf(vertex.texCoords.x);
+        out.texCoords[1] = floatToHalf(vertex.texCoords.y);
+    }
+
+    return packed;
+}
+
+}  // namespace personal::renderer::utility
@@ -0,0 +1,49 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace personal::renderer::utility {
+
+struct Vertex;
+
+// Quantized vertex for static meshes, 20 bytes against the 88 of Vertex:
+// - position: snorm16 relative to the mesh bounding box (w is padding)
+// - normal: octahedral encoded snorm16
+// - tangent: octahedral encoded snorm16 with the bitangent sign folded into
+//   the sign of y, see packTangent()
+// - texCoords: half floats
+// shaders/packed.vert decodes this layout.
+struct PackedVertex {
+    std::int16_t position[4];
+    std::int16_t normal[2];
+    std::int16_t tangent[2];
+    std::uint16_t texCoords[2];
+};
+
+// Maps snorm16 positions back into model space:
+// position = offset + scale * decoded snorm
+struct VertexQuantization {
+    glm::vec3 offset{0.0f};
+    glm::vec3 scale{1.0f};
+};
+
+std::uint16_t floatToHalf(float value);
+std::int16_t floatToSnorm16(float value);
+
+// octahedral encoding of a unit vector into [-1, 1]^2
+glm::vec2 octEncode(const glm::vec3& n);
+glm::vec3 octDecode(const glm::vec2& e);
+
+// quantizes the vertices relative to their bounding box, which is returned in
+// quantization so the shader can undo it
+std::vector<PackedVertex> packVertices(const Vertex* vertices,
+                                       std::size_t count,
+                                       VertexQuantization& quantization);
+
+}  // namespace personal::renderer::utility
+
+#endif  // VERTEX_PACKING_H
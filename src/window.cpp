@@ -25,8 +25,6 @@ Window::Window(int width, int height, std::string title, GLFWmonitor* monitor,
         std::exit(EXIT_FAILURE);
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -34,7 +32,17 @@ Window::Window(int width, int height, std::string title, GLFWmonitor* monitor,
 
     glfwWindowHint(GLFW_SAMPLES, 4);
 
-    window = glfwCreateWindow(width, height, title.c_str(), monitor, share);
+    // 4.3 for the compute culled asteroids (see
+    // InstancedModel::drawIndirect()), else 3.3, which is all the rest needs.
+    // macOS stops at 4.1, so it always falls back.
+    const int VERSIONS[][2] = {{4, 3}, {3, 3}};
+    window = nullptr;
+    for (const int* version : VERSIONS) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        window = glfwCreateWindow(width, height, title.c_str(), monitor, share);
+        if (window) break;
+    }
 
     if (!window) {
         std::cout << "Failed to create GLFW window\n";